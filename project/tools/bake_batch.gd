@@ -0,0 +1,51 @@
+extends SceneTree
+
+# bakes SMFs to WAV files on all cores without opening a window.
+# godot --headless --path <project> -s res://tools/bake_batch.gd -- [--bank b.gdsbank] [--out dir] [--bits 16] [--rate 48000] [--threads 0] files or folders...
+
+func _init()->void:
+	var files := PackedStringArray()
+	var bank := ""
+	var out := "user://baked"
+	var options := {}
+	var args := OS.get_cmdline_user_args()
+	var i := 0
+	while i < args.size():
+		var arg:String = args[i]
+		if arg.begins_with("--") and i + 1 < args.size():
+			match arg:
+				"--bank": bank = args[i + 1]
+				"--out": out = args[i + 1]
+				"--bits": options["bits"] = args[i + 1].to_int()
+				"--rate": options["rate"] = args[i + 1].to_float()
+				"--threads": options["threads"] = args[i + 1].to_int()
+				_: printerr("unknown option ", arg)
+			i += 2
+			continue
+		if DirAccess.dir_exists_absolute(arg):
+			for file in DirAccess.get_files_at(arg):
+				if file.get_extension().to_lower() in ["mid", "midi"]:
+					files.append(arg.path_join(file))
+		else:
+			files.append(arg)
+		i += 1
+
+	if files.is_empty():
+		printerr("no SMF given")
+		quit(1)
+		return
+
+	var manifest:Dictionary = GDSynthesizer.bake_batch(files, bank, out, options)
+	if manifest.is_empty():
+		printerr("bake failed, check the bank, the output folder and bits")
+		quit(1)
+		return
+	for entry in manifest["entries"]:
+		if entry["ok"]:
+			print("%s  %.1f sec  peak %.3f  x%.1f" % [entry["wav"], entry["seconds"], entry["peak"], entry["realtimeFactor"]])
+		else:
+			printerr("failed: ", entry["file"])
+	print("%d files, %.1f sec of sound in %.2f sec on %d threads (x%.1f)" % [
+		manifest["entries"].size(), manifest["seconds"], manifest["wallUsec"]/1000000.0,
+		manifest["threads"], manifest["realtimeFactor"]])
+	quit(0 if manifest["failed"] == 0 else 1)
@@ -28,26 +28,67 @@
 
 #include "gdsynthesizer.h"
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/audio_server.hpp>
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/json.hpp>
 
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
 #include <godot_cpp/variant/utility_functions.hpp> // for "UtilityFunctions::print()".
 #endif // DEBUG_ENABLED
 
 #include <filesystem>
+#include <set>
+#include <string>
 
 #include <cmath>
+#include <chrono>
+
+#if defined(WINDOWS_ENABLED)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h> // for render thread priority and affinity.
+#elif defined(UNIX_ENABLED)
+#include <pthread.h> // for render thread priority and affinity.
+#include <sched.h>
+#endif // WINDOWS_ENABLED
 
 using namespace godot;
 
 void GDSynthesizer::_bind_methods()
 {
-    ClassDB::bind_method(D_METHOD("init_synthe", "max_note"), &GDSynthesizer::initSynthe);
-    ClassDB::bind_method(D_METHOD("load_midi", "file_path"), &GDSynthesizer::loadMidi);
-    ClassDB::bind_method(D_METHOD("unload_midi"), &GDSynthesizer::unloadMidi);
+    ClassDB::bind_method(D_METHOD("init_synthe", "max_note", "buffer_length", "block_frames"), &GDSynthesizer::initSynthe, DEFVAL(0.1), DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("render_to_buffer", "file_path", "seconds"), &GDSynthesizer::renderToBuffer, DEFVAL(0.0));
+    ClassDB::bind_method(D_METHOD("render_to_wav", "file_path", "out_path", "bits", "seconds"), &GDSynthesizer::renderToWav, DEFVAL(16), DEFVAL(0.0));
+    ClassDB::bind_method(D_METHOD("benchmark_block_sizes", "sizes", "voices", "seconds"), &GDSynthesizer::benchmarkBlockSizes, DEFVAL(PackedInt32Array()), DEFVAL(32), DEFVAL(1.0));
+    ClassDB::bind_method(D_METHOD("load_midi", "file_path", "slot"), &GDSynthesizer::loadMidi, DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("unload_midi", "slot"), &GDSynthesizer::unloadMidi, DEFVAL(-1));
+    ClassDB::bind_method(D_METHOD("restart_midi", "slot"), &GDSynthesizer::restartMidi, DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("set_sequence_params", "slot", "p_dict"), &GDSynthesizer::setSequenceParams);
+    ClassDB::bind_method(D_METHOD("get_sequence_params", "slot"), &GDSynthesizer::getSequenceParams);
     ClassDB::bind_method(D_METHOD("feed_data", "delta"), &GDSynthesizer::feedData);
+    ClassDB::bind_method(D_METHOD("set_render_mode", "mode"), &GDSynthesizer::setRenderMode);
+    ClassDB::bind_method(D_METHOD("get_render_mode"), &GDSynthesizer::getRenderMode);
+    ClassDB::bind_method(D_METHOD("set_render_thread_params", "p_dict"), &GDSynthesizer::setRenderThreadParams);
+    ClassDB::bind_method(D_METHOD("get_render_thread_params"), &GDSynthesizer::getRenderThreadParams);
+    ClassDB::bind_method(D_METHOD("get_render_thread_stats"), &GDSynthesizer::getRenderThreadStats);
+    ClassDB::bind_method(D_METHOD("set_server_priority", "priority"), &GDSynthesizer::setServerPriority);
+    ClassDB::bind_method(D_METHOD("get_server_priority"), &GDSynthesizer::getServerPriority);
+    ClassDB::bind_static_method("GDSynthesizer", D_METHOD("set_server_params", "p_dict"), &GDSynthesizer::setServerParams);
+    ClassDB::bind_static_method("GDSynthesizer", D_METHOD("get_server_params"), &GDSynthesizer::getServerParams);
+    ClassDB::bind_static_method("GDSynthesizer", D_METHOD("get_server_stats"), &GDSynthesizer::getServerStats);
+    ClassDB::bind_static_method("GDSynthesizer", D_METHOD("bake_batch", "files", "bank_path", "out_dir", "options"), &GDSynthesizer::bakeBatch, DEFVAL(String()), DEFVAL(String("user://baked")), DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("set_feed_params", "p_dict"), &GDSynthesizer::setFeedParams);
+    ClassDB::bind_method(D_METHOD("get_feed_params"), &GDSynthesizer::getFeedParams);
+    ClassDB::bind_method(D_METHOD("get_feed_stats"), &GDSynthesizer::getFeedStats);
 
     ClassDB::bind_method(D_METHOD("set_synthe_params", "p_array"), &GDSynthesizer::setSyntheParams);
     ClassDB::bind_method(D_METHOD("get_synthe_params"), &GDSynthesizer::getSyntheParams);
+    ClassDB::bind_method(D_METHOD("get_instruments_packed"), &GDSynthesizer::getInstrumentsPacked);
+    ClassDB::bind_method(D_METHOD("set_instruments_packed", "data", "first"), &GDSynthesizer::setInstrumentsPacked, DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("get_instrument_version"), &GDSynthesizer::getInstrumentVersion);
+    ClassDB::bind_method(D_METHOD("load_bank", "file_path"), &GDSynthesizer::loadBank);
+    ClassDB::bind_method(D_METHOD("save_bank", "file_path"), &GDSynthesizer::saveBank);
 
     ClassDB::bind_method(D_METHOD("set_percussion_params", "p_array"), &GDSynthesizer::setPercussionParams);
     ClassDB::bind_method(D_METHOD("get_percussion_params"), &GDSynthesizer::getPercussionParams);
@@ -57,46 +98,389 @@ void GDSynthesizer::_bind_methods()
 
     ClassDB::bind_method(D_METHOD("set_note_on", "p_dict"), &GDSynthesizer::setNoteOn);
     ClassDB::bind_method(D_METHOD("set_note_off", "p_dict"), &GDSynthesizer::setNoteOff);
+    ClassDB::bind_method(D_METHOD("note_on", "channel", "key", "velocity", "program"), &GDSynthesizer::noteOn, DEFVAL(100), DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("note_off", "channel", "key"), &GDSynthesizer::noteOff);
+    ClassDB::bind_method(D_METHOD("submit_notes", "records"), &GDSynthesizer::submitNotes);
+    ClassDB::bind_method(D_METHOD("schedule_note", "time", "channel", "key", "velocity", "program", "length"), &GDSynthesizer::scheduleNote, DEFVAL(100), DEFVAL(0), DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("get_mix_rate"), &GDSynthesizer::getMixRate);
+    ClassDB::bind_method(D_METHOD("get_sample_clock"), &GDSynthesizer::getSampleClock);
+    ClassDB::bind_method(D_METHOD("set_note_signal_mode", "mode"), &GDSynthesizer::setNoteSignalMode);
+    ClassDB::bind_method(D_METHOD("get_note_signal_mode"), &GDSynthesizer::getNoteSignalMode);
+    ClassDB::bind_method(D_METHOD("poll_note_events"), &GDSynthesizer::pollNoteEvents);
+    ClassDB::bind_method(D_METHOD("get_dropped_note_events"), &GDSynthesizer::getDroppedNoteEvents);
+    ClassDB::bind_method(D_METHOD("get_levels", "per_channel"), &GDSynthesizer::getLevels, DEFVAL(false));
+    ClassDB::bind_method(D_METHOD("_flush_note_events"), &GDSynthesizer::flushNoteEvents);
     
     ClassDB::bind_method(D_METHOD("get_mini_wave_picture", "p_dict"), &GDSynthesizer::getMiniWavePicture);
     
     ADD_SIGNAL(MethodInfo("note_changed", PropertyInfo(Variant::STRING, "name"), PropertyInfo(Variant::DICTIONARY, "note")));
-    ADD_SIGNAL(MethodInfo("level_info", PropertyInfo(Variant::DICTIONARY, "level")));
+    ADD_SIGNAL(MethodInfo("note_events", PropertyInfo(Variant::PACKED_INT32_ARRAY, "events")));
+
+    BIND_ENUM_CONSTANT(RENDER_MODE_GENERATOR);
+    BIND_ENUM_CONSTANT(RENDER_MODE_STREAM);
+    BIND_ENUM_CONSTANT(RENDER_MODE_THREAD);
+    BIND_ENUM_CONSTANT(RENDER_MODE_SERVER);
+    BIND_ENUM_CONSTANT(NOTE_SIGNAL_NONE);
+    BIND_ENUM_CONSTANT(NOTE_SIGNAL_BATCH);
+    BIND_ENUM_CONSTANT(NOTE_SIGNAL_EACH);
+    BIND_CONSTANT(NOTE_EVENT_STRIDE);
+    BIND_CONSTANT(NOTE_RECORD_STRIDE);
+    BIND_CONSTANT(INSTRUMENT_STRIDE);
+    BIND_CONSTANT(MAX_SEQUENCES);
 }
 
 GDSynthesizer::GDSynthesizer()
 {
 	time_passed = 0;
-    sequencer.emitSignal = std::bind(&GDSynthesizer::emitSignal, this, std::placeholders::_1);
+    sequencer.notifyNoteEvents = std::bind(&GDSynthesizer::notifyNoteEvents, this);
+    noteEventBuf.reserve(1024);
+    serverPlayer.sequencer = &sequencer;
+    serverPlayer.renderAhead = [this](int64_t target) { return renderAhead(target); };
+    serverPlayer.runLocked = [this](const std::function<void(void)> &change) {
+        std::lock_guard<std::recursive_mutex> lock(renderMutex);
+        change();
+    };
 }
 
 GDSynthesizer::~GDSynthesizer()
 {
-    delete [] pcmBuf;
-    pcmBuf = nullptr;
+    stopRenderThread();
+    if (synthStream.is_valid()) {
+        synthStream->setOwner(nullptr, mix_rate); // waits for a running mix.
+    }
+    freeBus();
 }
 
-int GDSynthesizer::initSynthe(const int32_t max_note)
+void GDSynthesizer::allocBus(int32_t samples)
 {
-    sequencer.initParam(mix_rate, buffer_length/2.0, buf_samples/2);
-    Ref<AudioStreamGenerator> stream = memnew(AudioStreamGenerator);
-    set_stream(stream);
-    stream->set_mix_rate(mix_rate);
-    stream->set_buffer_length(buffer_length);
+    freeBus();
+    pcmBuf = static_cast<float*>(::operator new[](sizeof(float)*samples, std::align_val_t(busAlignment)));
+}
 
-    pcmBuf = new double[buf_samples/2];
-    frames = PackedVector2Array();
-    frames.resize((int64_t)buf_samples/2);
+void GDSynthesizer::freeBus(void)
+{
+    if (pcmBuf) {
+        ::operator delete[](pcmBuf, std::align_val_t(busAlignment));
+        pcmBuf = nullptr;
+    }
+}
 
+// block_frames is the render block, 0 is a half of buffer_length as before.
+// small blocks like 64-256 frames are for low latency with RENDER_MODE_STREAM or RENDER_MODE_THREAD.
+int GDSynthesizer::initSynthe(const int32_t max_note, const double p_buffer_length, const int32_t block_frames)
+{
+    stopRenderThread();
+    releaseStream(); // the mixer thread does not call mixFrames() while the bus is made again.
+    {
+        std::lock_guard<std::recursive_mutex> lock(renderMutex);
+        // rendered at the mixer's rate, so the audio server does not resample it.
+        if (AudioServer::get_singleton() != nullptr && AudioServer::get_singleton()->get_mix_rate() > 0.0) {
+            mix_rate = AudioServer::get_singleton()->get_mix_rate();
+        }
+        buffer_length = std::clamp(p_buffer_length, 0.005, 1.0);
+        buf_samples = int32_t(mix_rate*buffer_length);
+        busFrames = (block_frames > 0) ? std::clamp(block_frames, 16, 8192) : buf_samples/2;
+        sequencer.initParam(mix_rate, busFrames/mix_rate, busFrames);
+
+        busRead = busFrames;
+        allocBus(busFrames*2); // interleaved stereo.
+        frames = PackedVector2Array();
+        frames.resize((int64_t)busFrames);
+
+        setupStream();
+    }
+    startRenderThread();
     return 1;
 }
 
-void GDSynthesizer::unloadMidi(void)
+// setOwner() waits for a running mix, so the mixer thread has let go of the node after this.
+void GDSynthesizer::releaseStream(void)
+{
+    if (synthStream.is_valid()) {
+        synthStream->setOwner(nullptr, mix_rate);
+        synthStream = Ref<GDSynthesizerStream>();
+    }
+}
+
+void GDSynthesizer::setupStream(void)
+{
+    releaseStream();
+    if (renderMode == RENDER_MODE_STREAM) {
+        synthStream.instantiate();
+        synthStream->setOwner(this, mix_rate);
+        set_stream(synthStream);
+    }
+    else {
+        Ref<AudioStreamGenerator> stream = memnew(AudioStreamGenerator);
+        set_stream(stream);
+        fillCapacity = fillTarget = 0;
+        lastSkips = 0;
+        stream->set_mix_rate(mix_rate);
+        stream->set_buffer_length(std::max(buffer_length, 2.0*busFrames/mix_rate)); // at least 2 blocks.
+    }
+}
+
+void GDSynthesizer::setRenderMode(RenderMode mode)
+{
+    if (mode == renderMode) {
+        return;
+    }
+    bool playing = is_playing();
+    stopRenderThread();
+    renderMode = mode;
+    if (pcmBuf) { // already initialized, swap the stream now.
+        releaseStream();
+        {
+            std::lock_guard<std::recursive_mutex> lock(renderMutex);
+            busRead = busFrames;
+            setupStream();
+        }
+        startRenderThread();
+        if (playing) {
+            play();
+        }
+    }
+}
+
+GDSynthesizer::RenderMode GDSynthesizer::getRenderMode(void) const
 {
-    sequencer.smfUnload();
+    return renderMode;
 }
 
-int GDSynthesizer::loadMidi(const String &file_path)
+void GDSynthesizer::setRenderThreadParams(const Dictionary p_dic)
+{
+    threadLatency = std::clamp((double)p_dic.get("latency", threadLatency), 0.005, 1.0);
+    threadPriority = std::clamp((int32_t)p_dic.get("priority", threadPriority), 0, 2);
+    threadAffinity = std::max((int64_t)p_dic.get("affinity", threadAffinity), (int64_t)0);
+    if (threadRunning.load()) { // restart to apply.
+        stopRenderThread();
+        startRenderThread();
+    }
+}
+
+Dictionary GDSynthesizer::getRenderThreadParams(void)
+{
+    Dictionary dic;
+    dic["latency"] = threadLatency;
+    dic["priority"] = threadPriority;
+    dic["affinity"] = threadAffinity;
+    return dic;
+}
+
+// water marks are in frames and reset on each call.
+Dictionary GDSynthesizer::getRenderThreadStats(void)
+{
+    Dictionary dic;
+    dic["capacity"] = ring.getCapacity();
+    dic["fill"] = ring.readable();
+    dic["highWater"] = highWater;
+    dic["lowWater"] = lowWater;
+    dic["skips"] = 0;
+    dic["priorityApplied"] = isPriorityApplied.load();
+    dic["affinityApplied"] = isAffinityApplied.load();
+    if ((renderMode == RENDER_MODE_THREAD || renderMode == RENDER_MODE_SERVER) && is_playing()) {
+        Ref<AudioStreamGeneratorPlayback> playback = get_stream_playback();
+        if (playback.is_valid()) {
+            dic["skips"] = playback->get_skips();
+        }
+    }
+    highWater = 0;
+    lowWater = ring.getCapacity();
+    return dic;
+}
+
+void GDSynthesizer::startRenderThread(void)
+{
+    if ((renderMode != RENDER_MODE_THREAD && renderMode != RENDER_MODE_SERVER) || pcmBuf == nullptr || threadRunning.load() || isServerJoined) {
+        return;
+    }
+#if defined(WEB_ENABLED) && !defined(__EMSCRIPTEN_PTHREADS__)
+    renderMode = RENDER_MODE_GENERATOR; // no threads on this build.
+    return;
+#else
+    if (renderMode == RENDER_MODE_SERVER) {
+        SynthServer &server = SynthServer::getSingleton();
+        ring.init(int64_t(server.getLatency()*mix_rate) + busFrames);
+        highWater = 0;
+        lowWater = ring.getCapacity();
+        isServerJoined = server.addPlayer(&serverPlayer, mix_rate);
+        if (isServerJoined) {
+            return;
+        }
+        renderMode = RENDER_MODE_THREAD; // other mix rate than the server's one.
+    }
+    int64_t target = int64_t(threadLatency*mix_rate);
+    ring.init(target + busFrames);
+    highWater = 0;
+    lowWater = ring.getCapacity();
+    threadRunning.store(true);
+    renderThread = std::thread(&GDSynthesizer::renderThreadLoop, this);
+#endif
+}
+
+void GDSynthesizer::stopRenderThread(void)
+{
+    if (isServerJoined) {
+        SynthServer::getSingleton().removePlayer(&serverPlayer); // waits for a running pass.
+        isServerJoined = false;
+    }
+    if (!threadRunning.load()) {
+        return;
+    }
+    threadRunning.store(false);
+    if (renderThread.joinable()) {
+        renderThread.join();
+    }
+}
+
+// results are kept for get_render_thread_stats(), a setting the os refused or does not have is reported as not applied.
+// high priority on linux is SCHED_FIFO, which needs the rtprio limit or CAP_SYS_NICE.
+void GDSynthesizer::applyThreadPriority(void)
+{
+    bool isPriority = false;
+    bool isAffinity = (threadAffinity == 0);
+#if defined(WINDOWS_ENABLED)
+    static const int priorities[] = {THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_HIGHEST};
+    HANDLE handle = GetCurrentThread();
+    isPriority = (SetThreadPriority(handle, priorities[threadPriority]) != 0);
+    if (threadAffinity != 0) {
+        isAffinity = (SetThreadAffinityMask(handle, (DWORD_PTR)threadAffinity) != 0);
+    }
+#elif defined(UNIX_ENABLED) && !defined(WEB_ENABLED)
+    pthread_t self = pthread_self();
+    sched_param param {};
+    if (threadPriority == 2) {
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+        isPriority = (pthread_setschedparam(self, SCHED_FIFO, &param) == 0);
+    }
+    else {
+#if defined(LINUX_ENABLED)
+        int policy = (threadPriority == 0) ? SCHED_BATCH : SCHED_OTHER;
+#else
+        int policy = SCHED_OTHER;
+        param.sched_priority = (threadPriority == 0) ? sched_get_priority_min(SCHED_OTHER) : (sched_get_priority_min(SCHED_OTHER) + sched_get_priority_max(SCHED_OTHER))/2;
+#endif // LINUX_ENABLED
+        isPriority = (pthread_setschedparam(self, policy, &param) == 0);
+    }
+#if defined(LINUX_ENABLED)
+    if (threadAffinity != 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int32_t cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+            if ((threadAffinity >> cpu) & 1) CPU_SET(cpu, &set);
+        }
+        isAffinity = (pthread_setaffinity_np(self, sizeof(set), &set) == 0);
+    }
+#endif // LINUX_ENABLED, macOS has no affinity of threads.
+#else
+    isPriority = (threadPriority == 1); // the default of std::thread is normal.
+#endif // WINDOWS_ENABLED
+    isPriorityApplied.store(isPriority);
+    isAffinityApplied.store(isAffinity);
+}
+
+// renders blocks ahead until the ring holds threadLatency of frames.
+void GDSynthesizer::renderThreadLoop(void)
+{
+    applyThreadPriority();
+    const int64_t target = int64_t(threadLatency*mix_rate);
+    const auto nap = std::chrono::microseconds(int64_t(250000.0*busFrames/mix_rate)); // quarter block.
+    while (threadRunning.load(std::memory_order_acquire)) {
+        if (ring.readable() >= target || ring.writable() < busFrames) {
+            std::this_thread::sleep_for(nap);
+            continue;
+        }
+        renderAhead(target);
+    }
+}
+
+// renders blocks into the ring until it holds target frames, on the render thread or a worker of SynthServer.
+// returns seconds spent in feed(), waits on renderMutex are not counted.
+double GDSynthesizer::renderAhead(int64_t target)
+{
+    using clock = std::chrono::steady_clock;
+    clock::duration busy {0};
+    while (ring.readable() < target && ring.writable() >= busFrames) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(renderMutex);
+            auto begin = clock::now();
+            sequencer.feed(pcmBuf);
+            busy += clock::now() - begin;
+        }
+        for (int32_t i = 0; i < busFrames*2; i++) {
+            pcmBuf[i] = std::clamp(pcmBuf[i], -1.0f, 1.0f);
+        }
+        ring.write(pcmBuf, busFrames);
+    }
+    return std::chrono::duration<double>(busy).count();
+}
+
+// 0:lowest to 3:highest. voices of lower priority are limited first over the budget of the server.
+void GDSynthesizer::setServerPriority(const int32_t priority)
+{
+    serverPlayer.priority = std::clamp(priority, 0, VoicePool::numPriorities - 1);
+    if (isServerJoined) {
+        SynthServer::getSingleton().setPriority(&serverPlayer, serverPlayer.priority);
+    }
+}
+
+int32_t GDSynthesizer::getServerPriority(void) const
+{
+    return serverPlayer.priority;
+}
+
+// shared by all nodes: {"voices": 128, "latency": 0.1, "cpuBudget": 0.7, "threads": n}.
+void GDSynthesizer::setServerParams(const Dictionary p_dic)
+{
+    SynthServer::getSingleton().setParams(p_dic);
+}
+
+Dictionary GDSynthesizer::getServerParams(void)
+{
+    return SynthServer::getSingleton().getParams();
+}
+
+Dictionary GDSynthesizer::getServerStats(void)
+{
+    return SynthServer::getSingleton().getStats();
+}
+
+// slot -1 stops all slots and tones.
+void GDSynthesizer::unloadMidi(const int32_t slot)
+{
+    if (slot < 0) {
+        sequencer.smfUnload();
+    }
+    else {
+        sequencer.smfUnload(slot);
+    }
+}
+
+int GDSynthesizer::restartMidi(const int32_t slot)
+{
+    return sequencer.smfRestart(slot) ? 1 : 0;
+}
+
+// {"loop": true, "volume": 1.0, "channelOffset": 0, "tempo": 1.0} of a slot.
+void GDSynthesizer::setSequenceParams(const int32_t slot, const Dictionary p_dic)
+{
+    sequencer.setSlotParams(slot, p_dic);
+}
+
+Dictionary GDSynthesizer::getSequenceParams(const int32_t slot)
+{
+    return sequencer.getSlotParams(slot);
+}
+
+// slot 0 is the main song, others are layers or jingles played over it.
+// the file is parsed here, the render side takes it at next block without waiting for this call.
+int GDSynthesizer::loadMidi(const String &file_path, const int32_t slot)
+{
+    return loadSmf(sequencer, file_path, slot) ? 1 : 0;
+}
+
+// res:// and user:// paths are read by FileAccess, others by the file system.
+bool GDSynthesizer::loadSmf(Sequencer &target, const String &file_path, const int32_t slot)
 {
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
 	UtilityFunctions::print("input strings: ", file_path.utf8().ptr());
@@ -107,60 +491,284 @@ int GDSynthesizer::loadMidi(const String &file_path)
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
         UtilityFunctions::print("file exist, type 1");
 #endif // DEBUG_ENABLED
-        sequencer.smfLoad(file_path, 60000.0);
+        return target.smfLoad(file_path, slot);
     }
     else if (std::filesystem::is_regular_file(file_path.utf8().ptr())) {
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
         UtilityFunctions::print("file exist, type 2");
 #endif // DEBUG_ENABLED
-        sequencer.smfLoad(file_path.utf8().ptr(), 60000.0);
+        return target.smfLoad(file_path.utf8().ptr(), slot);
     }
-    else {
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-        UtilityFunctions::print(std::filesystem::current_path().c_str(), " is not file");
+    UtilityFunctions::print(std::filesystem::current_path().c_str(), " is not file");
 #endif // DEBUG_ENABLED
-        return 0;
-    }
-    return 1;
+    return false;
 }
 
 void GDSynthesizer::feedData(double delta) {
     time_passed += delta;
+    if (renderMode == RENDER_MODE_STREAM) {
+        return; // the mixer thread pulls by itself.
+    }
+    if (renderMode == RENDER_MODE_THREAD || renderMode == RENDER_MODE_SERVER) {
+        feedFromRing();
+        return;
+    }
     if (is_playing()) {
-        int32_t size = (int32_t)frames.size();
-        Ref<AudioStreamGeneratorPlayback> playback = get_stream_playback();
-        if (playback->can_push_buffer(size)) {
+        feedToTarget(delta);
+    }
+}
+
+// renders blocks until the playback holds fillTarget frames or feedBudget is used up,
+// so a long frame is recovered in one call.
+void GDSynthesizer::feedToTarget(double delta) {
+    int32_t size = (int32_t)frames.size();
+    Ref<AudioStreamGeneratorPlayback> playback = get_stream_playback();
+    int32_t available = playback->get_frames_available();
+    fillCapacity = std::max(fillCapacity, available);
+    if (fillTarget == 0) fillTarget = std::clamp((int32_t)(feedTargetTime*mix_rate), size, std::max(fillCapacity, size));
+    int32_t fill = fillCapacity - available;
+    adaptFill(playback->get_skips(), fill, delta);
+
+    uint64_t begin = Time::get_singleton()->get_ticks_usec();
+    while (fill < fillTarget && playback->can_push_buffer(size)) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(renderMutex);
             sequencer.feed(pcmBuf);
-            for (int32_t i = 0; i < size; i++) {
-                frames[i] = Vector2(pcmBuf[i], pcmBuf[i]);
-            }
-            playback->push_buffer(frames);
+        }
+        // clip and convert in one pass, with one copy-on-write check par frame.
+        Vector2 *dst = frames.ptrw();
+        const float *src = pcmBuf;
+        for (int32_t i = 0; i < size; i++) {
+            dst[i] = Vector2(std::clamp(src[i*2], -1.0f, 1.0f), std::clamp(src[i*2+1], -1.0f, 1.0f));
+        }
+        playback->push_buffer(frames);
+        fill += size;
+        blocksFed++;
+        if ((int64_t)(Time::get_singleton()->get_ticks_usec() - begin) >= feedBudget) {
+            budgetHits++;
+            break;
         }
     }
 }
 
+// underrun raises the target by a block at once, and a block is taken back
+// when the fill never went under 2 blocks for adaptInterval.
+void GDSynthesizer::adaptFill(int64_t skips, int32_t fill, double delta) {
+    int32_t size = (int32_t)frames.size();
+    if (skips < lastSkips) lastSkips = 0; // playback was restarted.
+    minFill = std::min(minFill, fill);
+    maxFill = std::max(maxFill, fill);
+    if (skips > lastSkips) {
+        underruns += skips - lastSkips;
+        lastSkips = skips;
+        if (isFeedAdaptive) fillTarget = std::min(fillTarget + size, std::max(fillCapacity, size));
+        stableTime = 0.0;
+        stableMinFill = fillCapacity;
+        return;
+    }
+    if (!isFeedAdaptive) return;
+    stableTime += delta;
+    stableMinFill = std::min(stableMinFill, fill);
+    if (stableTime >= adaptInterval) {
+        if (stableMinFill > size*2) fillTarget = std::max(fillTarget - size, size);
+        stableTime = 0.0;
+        stableMinFill = fillCapacity;
+    }
+}
 
-void GDSynthesizer::emitSignal(const godot::Dictionary dic) {
-    if ((int32_t)dic["msg"] == 0){
-        if ((int32_t)dic["onOff"] == 1){
-            emit_signal("note_changed", "note_on", dic);
+void GDSynthesizer::setFeedParams(const Dictionary p_dic) {
+    feedTargetTime = std::clamp((double)p_dic.get("target", feedTargetTime), 0.0, 2.0);
+    feedBudget = std::clamp((int64_t)p_dic.get("budget", feedBudget), (int64_t)100, (int64_t)100000);
+    isFeedAdaptive = (bool)p_dic.get("adaptive", isFeedAdaptive);
+    fillTarget = 0; // set again by next feed_data().
+}
+
+Dictionary GDSynthesizer::getFeedParams(void) {
+    Dictionary dic;
+    dic["target"] = feedTargetTime;
+    dic["budget"] = feedBudget;
+    dic["adaptive"] = isFeedAdaptive;
+    return dic;
+}
+
+// frames of the generator playback, min/max fill are reset on each call.
+Dictionary GDSynthesizer::getFeedStats(void) {
+    Dictionary dic;
+    dic["capacity"] = fillCapacity;
+    dic["target"] = fillTarget;
+    dic["minFill"] = minFill;
+    dic["maxFill"] = maxFill;
+    dic["underruns"] = underruns;
+    dic["budgetHits"] = budgetHits;
+    dic["blocks"] = blocksFed;
+    minFill = fillCapacity;
+    maxFill = 0;
+    return dic;
+}
+
+// copies frames rendered by the render thread, nothing is rendered here.
+void GDSynthesizer::feedFromRing(void) {
+    if (!is_playing()) {
+        return;
+    }
+    static_assert(sizeof(Vector2) == sizeof(float)*2, "Vector2 must be 2 floats");
+    int32_t size = (int32_t)frames.size();
+    Ref<AudioStreamGeneratorPlayback> playback = get_stream_playback();
+    int64_t fill = ring.readable();
+    highWater = std::max(highWater, fill);
+    lowWater = std::min(lowWater, fill);
+    while (fill >= size && playback->can_push_buffer(size)) {
+        ring.read(reinterpret_cast<float*>(frames.ptrw()), size);
+        playback->push_buffer(frames);
+        fill -= size;
+    }
+    if (isServerJoined) {
+        SynthServer::getSingleton().notifyRead(fill);
+    }
+}
+
+// called from the mixer thread in stream mode. no lock of the main thread is taken here,
+// its input comes through the command queue and the stream is released before the bus is changed.
+bool GDSynthesizer::mixFrames(AudioFrame *buffer, int32_t frames) {
+    if (pcmBuf == nullptr) {
+        return false;
+    }
+    int32_t done = 0;
+    while (done < frames) {
+        if (busRead >= busFrames) {
+            sequencer.feed(pcmBuf);
+            busRead = 0;
         }
-        else{
-            emit_signal("note_changed", "note_off", dic);
+        int32_t n = std::min(frames - done, busFrames - busRead);
+        const float *src = pcmBuf + busRead*2;
+        AudioFrame *dst = buffer + done;
+        for (int32_t i = 0; i < n; i++) {
+            dst[i].left = std::clamp(src[i*2], -1.0f, 1.0f);
+            dst[i].right = std::clamp(src[i*2+1], -1.0f, 1.0f);
         }
+        busRead += n;
+        done += n;
+    }
+    return true;
+}
+
+
+// render side, once at end of a frame with note events.
+void GDSynthesizer::notifyNoteEvents(void) {
+    if (noteSignalMode == NOTE_SIGNAL_NONE) {
+        return;
     }
-    else if ((int32_t)dic["msg"] == 1){
-        emit_signal("level_info", dic);
+    if (renderMode == RENDER_MODE_GENERATOR) {
+        flushNoteEvents(); // already on the main thread.
     }
+    else if (!isNoteFlushPending.exchange(true)) {
+        call_deferred("_flush_note_events"); // frames until the main thread runs are coalesced.
+    }
+}
+
+void GDSynthesizer::flushNoteEvents(void) {
+    isNoteFlushPending.store(false);
+    if (noteSignalMode == NOTE_SIGNAL_BATCH) {
+        PackedInt32Array events = pollNoteEvents();
+        if (events.size() > 0) {
+            emit_signal("note_events", events);
+        }
+    }
+    else if (noteSignalMode == NOTE_SIGNAL_EACH) {
+        NoteEvent event;
+        while (sequencer.popNoteEvent(event)) {
+            Dictionary dic;
+            dic["msg"]                = (int32_t)0;
+            dic["onOff"]              = event.onOff;
+            dic["trackNum"]           = event.trackNum;
+            dic["channel"]            = event.channel;
+            dic["velocity"]           = event.velocity;
+            dic["program"]            = event.program;
+            dic["key"]                = event.key;
+            dic["instrumentNum"]      = event.instrumentNum;
+            dic["key2"]               = event.key2;
+            emit_signal("note_changed", event.onOff == 1 ? "note_on" : "note_off", dic);
+        }
+    }
+}
+
+// main thread. NOTE_EVENT_STRIDE ints par event in order of NoteEvent.
+PackedInt32Array GDSynthesizer::pollNoteEvents(void) {
+    NoteEvent event;
+    noteEventBuf.clear();
+    while (noteEventBuf.size() < noteEventBuf.capacity() && sequencer.popNoteEvent(event)) {
+        noteEventBuf.push_back(event);
+    }
+    static_assert(sizeof(NoteEvent) == sizeof(int32_t)*NOTE_EVENT_STRIDE, "NoteEvent must be packed ints");
+    PackedInt32Array events;
+    events.resize((int64_t)noteEventBuf.size()*NOTE_EVENT_STRIDE);
+    if (!noteEventBuf.empty()) {
+        std::memcpy(events.ptrw(), noteEventBuf.data(), sizeof(NoteEvent)*noteEventBuf.size());
+    }
+    return events;
+}
+
+int64_t GDSynthesizer::getDroppedNoteEvents(void) {
+    return sequencer.getDroppedNoteEvents();
+}
+
+// peak L, peak R, rms L, rms R, and peak, rms of 32 MIDI channels when per_channel.
+// peaks are max since last call. channels need "channelMeters" in control params.
+PackedFloat32Array GDSynthesizer::getLevels(bool per_channel) {
+    float levels[Sequencer::maxLevels];
+    int32_t n = sequencer.getLevels(levels, per_channel);
+    PackedFloat32Array array;
+    array.resize(n);
+    std::memcpy(array.ptrw(), levels, sizeof(float)*n);
+    return array;
+}
+
+void GDSynthesizer::setNoteSignalMode(NoteSignalMode mode) {
+    noteSignalMode = mode;
 }
 
+GDSynthesizer::NoteSignalMode GDSynthesizer::getNoteSignalMode(void) const {
+    return noteSignalMode;
+}
 
 void GDSynthesizer::setSyntheParams(const Array p_array) {
     sequencer.setInstruments(p_array);
 }
 
 Array GDSynthesizer::getSyntheParams(void) {
-    return sequencer.getInstruments();
+    return sequencer.getInstruments(); // published bank, no need to wait for the render side.
+}
+
+PackedFloat32Array GDSynthesizer::getInstrumentsPacked(void) {
+    return sequencer.getInstrumentsPacked();
+}
+
+// data is INSTRUMENT_STRIDE floats par instrument from first, so one instrument can be sent alone.
+int32_t GDSynthesizer::setInstrumentsPacked(const PackedFloat32Array data, const int32_t first) {
+    return sequencer.setInstrumentsPacked(data.ptr(), data.size(), first);
+}
+
+int64_t GDSynthesizer::getInstrumentVersion(void) {
+    return (int64_t)sequencer.getInstrumentVersion();
+}
+
+// .gdsbank is read at once and swapped in as a whole, the bank in use is kept when it is invalid.
+int GDSynthesizer::loadBank(const String &p_file) {
+    if (!FileAccess::file_exists(p_file)) {
+        return 0;
+    }
+    PackedByteArray bytes = FileAccess::get_file_as_bytes(p_file);
+    return sequencer.setBankBytes(bytes.ptr(), bytes.size()) ? 1 : 0;
+}
+
+int GDSynthesizer::saveBank(const String &p_file) {
+    Ref<FileAccess> out = FileAccess::open(p_file, FileAccess::WRITE);
+    if (out.is_null() || !out->is_open()) {
+        return 0;
+    }
+    out->store_buffer(sequencer.getBankBytes());
+    return 1;
 }
 
 void GDSynthesizer::setPercussionParams(const Array p_array) {
@@ -179,6 +787,32 @@ void GDSynthesizer::setNoteOff(const Dictionary p_dic) {
     sequencer.incertNoteOff(p_dic);
 }
 
+void GDSynthesizer::noteOn(const int32_t channel, const int32_t key, const int32_t velocity, const int32_t program) {
+    sequencer.noteOn(-1, channel, key, velocity, program);
+}
+
+void GDSynthesizer::noteOff(const int32_t channel, const int32_t key) {
+    sequencer.noteOff(-1, channel, key);
+}
+
+// whole records in one call, a tail shorter than NOTE_RECORD_STRIDE is ignored.
+int64_t GDSynthesizer::submitNotes(const PackedInt32Array records) {
+    return sequencer.submitNotes(records.ptr(), records.size()/NOTE_RECORD_STRIDE);
+}
+
+// time is sample on get_sample_clock(), and note off is also scheduled when length is given in samples.
+// notes wait in a heap of the render side and start at exact sample of the frame.
+void GDSynthesizer::scheduleNote(const int64_t time, const int32_t channel, const int32_t key, const int32_t velocity, const int32_t program, const int64_t length) {
+    sequencer.noteOn(time, channel, key, velocity, program);
+    if (length > 0) {
+        sequencer.noteOff(time + length, channel, key);
+    }
+}
+
+double GDSynthesizer::getMixRate(void) const {
+    return mix_rate;
+}
+
 void GDSynthesizer::setControlParams(const Dictionary p_dic) {
     sequencer.setControlParams(p_dic);
 }
@@ -187,6 +821,229 @@ Dictionary GDSynthesizer::getControlParams(void) {
     return sequencer.getControlParams();
 }
 
+int64_t GDSynthesizer::getSampleClock(void) {
+    return sequencer.getSampleClock();
+}
+
+// renders held notes with a private sequencer for each block size, so playback is not disturbed.
+// "usec" is the cost par block and "load" is its ratio to the time the block plays.
+Dictionary GDSynthesizer::benchmarkBlockSizes(const PackedInt32Array sizes, const int32_t voices, const double seconds) {
+    PackedInt32Array list = sizes;
+    if (list.is_empty()) {
+        for (int32_t size : {64, 128, 256, 512, 1024, 2205}) list.push_back(size);
+    }
+    Dictionary result;
+    auto bench = std::make_unique<Sequencer>();
+    for (int64_t n = 0; n < list.size(); n++) {
+        int32_t size = std::clamp(list[n], 16, 8192);
+        bench->initParam(mix_rate, size/mix_rate, size);
+        auto bus = std::make_unique<float[]>(size*2);
+        for (int32_t v = 0; v < std::clamp(voices, 1, 64); v++) {
+            Dictionary note;
+            note["channel"] = (v % 15 < 9) ? v % 15 : v % 15 + 1; // not on percussions.
+            note["key"] = 36 + v % 48;
+            note["velocity"] = 100;
+            note["program"] = v % 8;
+            note["tempo"] = 120;
+            bench->incertNoteOn(note);
+        }
+        bench->feed(bus.get()); // note on is not timed.
+        int64_t blocks = std::max((int64_t)(seconds*mix_rate/size), (int64_t)1);
+        uint64_t begin = Time::get_singleton()->get_ticks_usec();
+        for (int64_t i = 0; i < blocks; i++) {
+            bench->feed(bus.get());
+        }
+        double used = (double)(Time::get_singleton()->get_ticks_usec() - begin);
+        Dictionary one;
+        one["usec"] = used/(double)blocks;
+        one["load"] = used/((double)blocks*size/mix_rate*1000000.0);
+        result[size] = one;
+    }
+    return result;
+}
+
+// a private sequencer plays the smf once at rate, setBank gives it the instruments.
+bool GDSynthesizer::prepareOffline(Sequencer &target, double rate, const String &p_file, const std::function<bool(Sequencer &)> &setBank) {
+    return OfflineRender::prepare(target, rate, [&](Sequencer &one) {
+        return setBank(one) && loadSmf(one, p_file, 0);
+    });
+}
+
+Dictionary GDSynthesizer::offlineStats(const OfflineRender::Stats &stats, double rate) {
+    Dictionary dic;
+    dic["frames"] = stats.frames;
+    dic["seconds"] = (double)stats.frames/rate;
+    dic["usec"] = stats.usec;
+    dic["realtimeFactor"] = stats.realtimeFactor;
+    dic["peak"] = stats.peak;
+    dic["ended"] = stats.isEnded;
+    return dic;
+}
+
+// seconds 0 renders until the last tone of the smf is released.
+// returns stats and "data" of frames as push_buffer() takes, or empty on failure.
+Dictionary GDSynthesizer::renderToBuffer(const String &p_file, const double seconds) {
+    auto offline = std::make_unique<Sequencer>();
+    if (!prepareOffline(*offline, mix_rate, p_file, [this](Sequencer &one) { one.copyBank(sequencer); return true; })) {
+        return Dictionary();
+    }
+    // blocks are written straight into the array, which grows twice at a time and is cut to the frames at last.
+    static_assert(sizeof(Vector2) == sizeof(float)*2, "Vector2 must be 2 floats");
+    PackedVector2Array data;
+    int64_t used = 0;
+    OfflineRender::Stats stats = OfflineRender::render(*offline, mix_rate, seconds, [&](const float *src, int32_t frames) {
+        if (used + frames > data.size()) {
+            data.resize(std::max(used + frames, data.size()*2));
+        }
+        std::copy(src, src + frames*2, reinterpret_cast<float*>(data.ptrw() + used));
+        used += frames;
+    });
+    data.resize(stats.frames);
+    Dictionary dic = offlineStats(stats, mix_rate);
+    dic["data"] = data;
+    return dic;
+}
+
+// bits are 16, 24 (PCM) or 32 (float). returns stats, or empty on failure.
+Dictionary GDSynthesizer::renderToWav(const String &p_file, const String &out_path, const int32_t bits, const double seconds) {
+    if (!OfflineRender::isValidBits(bits)) {
+        return Dictionary();
+    }
+    auto offline = std::make_unique<Sequencer>();
+    if (!prepareOffline(*offline, mix_rate, p_file, [this](Sequencer &one) { one.copyBank(sequencer); return true; })) {
+        return Dictionary();
+    }
+    OfflineRender::Stats stats;
+    if (!writeWav(*offline, mix_rate, out_path, bits, seconds, stats)) {
+        return Dictionary();
+    }
+    return offlineStats(stats, mix_rate);
+}
+
+// header is written again with the length at the end. false on a write error or a short file.
+bool GDSynthesizer::writeWav(Sequencer &target, double rate, const String &out_path, const int32_t bits, const double seconds, OfflineRender::Stats &stats) {
+    Ref<FileAccess> out = FileAccess::open(out_path, FileAccess::WRITE);
+    if (out.is_null() || !out->is_open()) {
+        return false;
+    }
+    PackedByteArray header;
+    header.resize(OfflineRender::wavHeaderSize(bits));
+    OfflineRender::makeWavHeader(header.ptrw(), (int32_t)rate, bits, 0);
+    out->store_buffer(header);
+    PackedByteArray chunk;
+    chunk.resize((int64_t)OfflineRender::blockFrames*2*bits/8);
+    bool isFailed = false;
+    stats = OfflineRender::render(target, rate, seconds, [&](const float *src, int32_t frames) {
+        if (isFailed) return; // e.g. the disk is full, rendering goes on but is not written.
+        int64_t size = OfflineRender::encodeFrames(src, frames, bits, chunk.ptrw());
+        if (size != chunk.size()) chunk.resize(size); // last block.
+        out->store_buffer(chunk);
+        isFailed = (out->get_error() != OK);
+    });
+    OfflineRender::makeWavHeader(header.ptrw(), (int32_t)rate, bits, stats.frames);
+    out->seek(0);
+    out->store_buffer(header);
+    out->flush();
+    isFailed = isFailed || (out->get_error() != OK);
+    out->close();
+    if (isFailed) {
+        return false;
+    }
+    // store_buffer() of godot 4.2 does not always report a failed write, so the length on the disk is checked too.
+    Ref<FileAccess> written = FileAccess::open(out_path, FileAccess::READ);
+    return written.is_valid() && written->is_open()
+        && written->get_length() == (uint64_t)(header.size() + stats.frames*2*bits/8);
+}
+
+// each smf gets its own sequencer on a core of the pool, they share only the read-only LUTs of LUTRegistry.
+// options are "bits" (16), "rate" (AudioServer's one) and "threads" (0 is all cores).
+// wavs are out_dir/<name>.wav, and the returned manifest is also written as out_dir/manifest.json.
+Dictionary GDSynthesizer::bakeBatch(const PackedStringArray files, const String &bank_path, const String &out_dir, const Dictionary options) {
+    double defaultRate = 48000.0;
+    if (AudioServer::get_singleton() != nullptr && AudioServer::get_singleton()->get_mix_rate() > 0.0) {
+        defaultRate = AudioServer::get_singleton()->get_mix_rate();
+    }
+    int32_t bits = (int32_t)options.get("bits", 16);
+    double rate = std::clamp((double)options.get("rate", defaultRate), 8000.0, 192000.0);
+    int32_t threads = (int32_t)options.get("threads", 0);
+    int32_t count = (int32_t)files.size();
+    if (!OfflineRender::isValidBits(bits) || count == 0) {
+        return Dictionary();
+    }
+    PackedByteArray bank; // read once, every sequencer parses the same bytes.
+    if (!bank_path.is_empty()) {
+        bank = FileAccess::get_file_as_bytes(bank_path);
+        if (bank.is_empty()) {
+            return Dictionary();
+        }
+    }
+    if (DirAccess::make_dir_recursive_absolute(out_dir) != OK) {
+        return Dictionary();
+    }
+
+    // same names from other folders get _1, _2...
+    std::vector<String> wavPaths(count);
+    std::set<std::string> usedNames;
+    for (int32_t i = 0; i < count; i++) {
+        String base = files[i].get_file().get_basename();
+        String name = base;
+        for (int32_t n = 1; usedNames.count(name.utf8().get_data()) != 0; n++) {
+            name = base + "_" + String::num_int64(n);
+        }
+        usedNames.insert(name.utf8().get_data());
+        wavPaths[i] = out_dir.path_join(name + ".wav");
+    }
+
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    threads = std::clamp(threads, 1, count);
+    std::vector<OfflineRender::Stats> results(count);
+    std::vector<uint8_t> isDone(count, 0);
+    auto setBank = [&](Sequencer &one) { // no bank is the default instruments.
+        return bank.is_empty() || one.setBankBytes(bank.ptr(), bank.size());
+    };
+    WorkerPool pool;
+    pool.resize(threads - 1); // the caller is worker 0.
+    uint64_t begin = Time::get_singleton()->get_ticks_usec();
+    pool.run(count, [&](int32_t i, int32_t worker) {
+        auto offline = std::make_unique<Sequencer>();
+        offline->setRenderThreads(0); // parallel par file, not par voice.
+        isDone[i] = (prepareOffline(*offline, rate, files[i], setBank) && writeWav(*offline, rate, wavPaths[i], bits, 0.0, results[i])) ? 1 : 0;
+    });
+    double wall = (double)(Time::get_singleton()->get_ticks_usec() - begin);
+
+    Array entries;
+    int64_t totalFrames = 0;
+    int32_t failed = 0;
+    for (int32_t i = 0; i < count; i++) {
+        Dictionary one = isDone[i] ? offlineStats(results[i], rate) : Dictionary();
+        one["file"] = files[i];
+        one["wav"] = isDone[i] ? wavPaths[i] : String();
+        one["ok"] = (isDone[i] != 0);
+        if (isDone[i]) {
+            totalFrames += results[i].frames;
+        } else {
+            failed++;
+        }
+        entries.push_back(one);
+    }
+    Dictionary manifest;
+    manifest["bank"] = bank_path;
+    manifest["rate"] = rate;
+    manifest["bits"] = bits;
+    manifest["threads"] = threads;
+    manifest["wallUsec"] = wall;
+    manifest["seconds"] = (double)totalFrames/rate;
+    manifest["realtimeFactor"] = (wall > 0.0) ? (double)totalFrames/rate*1000000.0/wall : 0.0; // of the whole batch, a run with "threads" 1 is the base of the gain.
+    manifest["failed"] = failed;
+    manifest["entries"] = entries;
+    Ref<FileAccess> out = FileAccess::open(out_dir.path_join("manifest.json"), FileAccess::WRITE);
+    if (out.is_valid() && out->is_open()) {
+        out->store_string(JSON::stringify(manifest, "\t"));
+        out->close();
+    }
+    return manifest;
+}
+
 Ref<Image> GDSynthesizer::getMiniWavePicture(const Dictionary p_dic) {
     return sequencer.getMiniWavePicture(p_dic);
 }
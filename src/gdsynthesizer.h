@@ -35,33 +35,151 @@
 #include <godot_cpp/classes/image.hpp>
 #include <godot_cpp/classes/file_access.hpp>
 #include <functional>
+#include <new>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 #include "sequencer.hpp"
+#include "pcmring.hpp"
+#include "synthserver.hpp"
+#include "offlinerender.hpp"
+#include "gdsynthesizer_stream.h"
 
 namespace godot {
 
 class GDSynthesizer : public AudioStreamPlayer {
     GDCLASS(GDSynthesizer, AudioStreamPlayer);
+public:
+    enum RenderMode {
+        RENDER_MODE_GENERATOR, // 0, pushed into AudioStreamGenerator by feed_data().
+        RENDER_MODE_STREAM, // 1, pulled by the audio server's mixer thread.
+        RENDER_MODE_THREAD, // 2, rendered ahead by own thread, copied by feed_data().
+        RENDER_MODE_SERVER, // 3, rendered ahead by SynthServer with other nodes, copied by feed_data().
+    };
+    enum NoteSignalMode {
+        NOTE_SIGNAL_NONE, // 0, only poll_note_events().
+        NOTE_SIGNAL_BATCH, // 1, one note_events signal par frame.
+        NOTE_SIGNAL_EACH, // 2, note_changed signal par event.
+    };
+    static constexpr int32_t NOTE_EVENT_STRIDE = 8; // ints par event in poll_note_events().
+    static constexpr int32_t NOTE_RECORD_STRIDE = Sequencer::noteRecordStride; // ints par record in submit_notes().
+    static constexpr int32_t INSTRUMENT_STRIDE = Sequencer::instrumentStride; // floats par instrument in packed bank.
+    static constexpr int32_t MAX_SEQUENCES = Sequencer::numSlots; // smf played at once by load_midi() slots.
+private:
 
-    static constexpr double mix_rate = 44100.0; // Sampling frq. It's also the samples num par sec.
-    static constexpr double buffer_length = 0.1; // Buffer length in seconds.
+    double mix_rate = 44100.0; // Sampling frq. It's also the samples num par sec, AudioServer's one from init_synthe().
+    double buffer_length = 0.1; // Buffer length in seconds, given by init_synthe().
 
     int32_t buf_samples = int32_t(mix_rate*buffer_length);
     double time_passed;
     PackedVector2Array frames;
+    static constexpr size_t busAlignment = 64; // cache line.
+    void allocBus(int32_t);
+    void freeBus(void);
+
+    RenderMode renderMode = RENDER_MODE_GENERATOR;
+    Ref<GDSynthesizerStream> synthStream;
+    std::recursive_mutex renderMutex; // keeps feed() out of init and voice pool changes, never taken by the mixer thread.
+    int32_t busFrames = 0; // frames par sequencer block.
+    int32_t busRead = 0; // frames of pcmBuf already mixed in stream mode.
+    void setupStream(void);
+    void releaseStream(void);
+
+    NoteSignalMode noteSignalMode = NOTE_SIGNAL_EACH;
+    std::atomic<bool> isNoteFlushPending {false};
+    std::vector<NoteEvent> noteEventBuf;
+    void notifyNoteEvents(void);
+
+    // render thread of RENDER_MODE_THREAD.
+    std::thread renderThread;
+    std::atomic<bool> threadRunning {false};
+    PcmRing ring;
+    double threadLatency = 0.1; // seconds rendered ahead.
+    int32_t threadPriority = 2; // 0:low, 1:normal, 2:high.
+    int64_t threadAffinity = 0; // cpu mask, 0 is any.
+    std::atomic<bool> isPriorityApplied {false}; // what the os took by applyThreadPriority().
+    std::atomic<bool> isAffinityApplied {false};
+    int64_t highWater = 0; // max/min frames in ring seen by feed_data().
+    int64_t lowWater = 0;
+    void startRenderThread(void);
+    void stopRenderThread(void);
+    void renderThreadLoop(void);
+    double renderAhead(int64_t target);
+    void applyThreadPriority(void);
+    void feedFromRing(void);
+
+    // RENDER_MODE_SERVER, the node only holds its sequencer and ring.
+    ServerPlayer serverPlayer;
+    bool isServerJoined = false;
+
+    // fill-to-target of the generator playback, in frames.
+    double feedTargetTime = buffer_length; // seconds, initial target.
+    int64_t feedBudget = 4000; // usec of rendering par feed_data().
+    bool isFeedAdaptive = true;
+    int32_t fillCapacity = 0; // max frames available ever seen.
+    int32_t fillTarget = 0;
+    int64_t lastSkips = 0;
+    int64_t underruns = 0;
+    int64_t budgetHits = 0;
+    int64_t blocksFed = 0;
+    int32_t minFill = INT32_MAX;
+    int32_t maxFill = 0;
+    double stableTime = 0.0; // seconds without underrun.
+    int32_t stableMinFill = INT32_MAX;
+    static constexpr double adaptInterval = 4.0;
+    void feedToTarget(double delta);
+
+    static bool loadSmf(Sequencer &target, const String &p_file, const int32_t slot);
+    static bool prepareOffline(Sequencer &target, double rate, const String &p_file, const std::function<bool(Sequencer &)> &setBank);
+    static bool writeWav(Sequencer &target, double rate, const String &out_path, const int32_t bits, const double seconds, OfflineRender::Stats &stats);
+    static Dictionary offlineStats(const OfflineRender::Stats &stats, double rate);
+    void adaptFill(int64_t skips, int32_t fill, double delta);
 protected:
     static void _bind_methods();
 public:
-    double* pcmBuf = nullptr;
+    float* pcmBuf = nullptr; // interleaved stereo mix bus aligned by busAlignment.
     Sequencer sequencer;
     GDSynthesizer();
     ~GDSynthesizer();
     void feedData(double delta);
-    int initSynthe(const int32_t max_note);
-    int loadMidi(const String &p_file);
-    void unloadMidi(void);
+    bool mixFrames(AudioFrame *buffer, int32_t frames);
+    void setRenderMode(RenderMode mode);
+    RenderMode getRenderMode(void) const;
+    void setRenderThreadParams(const Dictionary);
+    Dictionary getRenderThreadParams(void);
+    Dictionary getRenderThreadStats(void);
+    void setServerPriority(const int32_t priority);
+    int32_t getServerPriority(void) const;
+    static void setServerParams(const Dictionary);
+    static Dictionary getServerParams(void);
+    static Dictionary getServerStats(void);
+    void setFeedParams(const Dictionary);
+    Dictionary getFeedParams(void);
+    Dictionary getFeedStats(void);
+    void setNoteSignalMode(NoteSignalMode mode);
+    NoteSignalMode getNoteSignalMode(void) const;
+    PackedInt32Array pollNoteEvents(void);
+    int64_t getDroppedNoteEvents(void);
+    PackedFloat32Array getLevels(bool per_channel);
+    void flushNoteEvents(void);
+    int initSynthe(const int32_t max_note, const double p_buffer_length, const int32_t block_frames);
+    Dictionary renderToBuffer(const String &p_file, const double seconds);
+    Dictionary renderToWav(const String &p_file, const String &out_path, const int32_t bits, const double seconds);
+    static Dictionary bakeBatch(const PackedStringArray files, const String &bank_path, const String &out_dir, const Dictionary options);
+    Dictionary benchmarkBlockSizes(const PackedInt32Array sizes, const int32_t voices, const double seconds);
+    int loadMidi(const String &p_file, const int32_t slot);
+    void unloadMidi(const int32_t slot);
+    int restartMidi(const int32_t slot);
+    void setSequenceParams(const int32_t slot, const Dictionary);
+    Dictionary getSequenceParams(const int32_t slot);
     void setSyntheParams(const Array);
     Array getSyntheParams(void);
+    PackedFloat32Array getInstrumentsPacked(void);
+    int32_t setInstrumentsPacked(const PackedFloat32Array data, const int32_t first);
+    int64_t getInstrumentVersion(void);
+    int loadBank(const String &p_file);
+    int saveBank(const String &p_file);
 
     void setPercussionParams(const Array);
     Array getPercussionParams(void);
@@ -71,10 +189,18 @@ public:
 
     void setNoteOn(const Dictionary);
     void setNoteOff(const Dictionary);
+    void noteOn(const int32_t channel, const int32_t key, const int32_t velocity, const int32_t program);
+    void noteOff(const int32_t channel, const int32_t key);
+    int64_t submitNotes(const PackedInt32Array records);
+    void scheduleNote(const int64_t time, const int32_t channel, const int32_t key, const int32_t velocity, const int32_t program, const int64_t length);
+    double getMixRate(void) const;
+    int64_t getSampleClock(void);
     Ref<Image> getMiniWavePicture(const Dictionary);
     
-    void emitSignal(const godot::Dictionary dic);
 };
 }
 
+VARIANT_ENUM_CAST(GDSynthesizer::RenderMode);
+VARIANT_ENUM_CAST(GDSynthesizer::NoteSignalMode);
+
 #endif // GDSYNTHESIZER_H
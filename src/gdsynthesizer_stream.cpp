@@ -0,0 +1,124 @@
+/**************************************************************************/
+/*  gdsynthesizer_stream.cpp                                              */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include "gdsynthesizer_stream.h"
+#include "gdsynthesizer.h"
+#include <godot_cpp/core/class_db.hpp>
+
+using namespace godot;
+
+void GDSynthesizerStream::_bind_methods()
+{
+}
+
+void GDSynthesizerStream::setOwner(GDSynthesizer *p_owner, double p_mix_rate)
+{
+    std::lock_guard<std::mutex> lock(ownerMutex);
+    owner = p_owner;
+    mixRate = p_mix_rate;
+}
+
+Ref<AudioStreamPlayback> GDSynthesizerStream::_instantiate_playback() const
+{
+    Ref<GDSynthesizerStreamPlayback> playback;
+    playback.instantiate();
+    playback->stream = Ref<GDSynthesizerStream>(const_cast<GDSynthesizerStream*>(this));
+    return playback;
+}
+
+String GDSynthesizerStream::_get_stream_name() const
+{
+    return "GDSynthesizer";
+}
+
+double GDSynthesizerStream::_get_length() const
+{
+    return 0.0; // endless.
+}
+
+bool GDSynthesizerStream::_is_monophonic() const
+{
+    return true; // all playbacks would share the one sequencer.
+}
+
+
+void GDSynthesizerStreamPlayback::_bind_methods()
+{
+}
+
+void GDSynthesizerStreamPlayback::_start(double p_from_pos)
+{
+    if (active) {
+        return;
+    }
+    active = true;
+    begin_resample();
+}
+
+void GDSynthesizerStreamPlayback::_stop()
+{
+    active = false;
+}
+
+bool GDSynthesizerStreamPlayback::_is_playing() const
+{
+    return active;
+}
+
+int32_t GDSynthesizerStreamPlayback::_get_loop_count() const
+{
+    return 0;
+}
+
+double GDSynthesizerStreamPlayback::_get_playback_position() const
+{
+    return 0.0;
+}
+
+void GDSynthesizerStreamPlayback::_seek(double p_position)
+{
+    // the sequencer has no seek.
+}
+
+int32_t GDSynthesizerStreamPlayback::_mix_resampled(AudioFrame *p_buffer, int32_t p_frames)
+{
+    // never block the mixer thread, a busy owner plays silence for this call.
+    std::unique_lock<std::mutex> lock(stream->ownerMutex, std::try_to_lock);
+    if (!active || !lock.owns_lock() || stream->owner == nullptr || !stream->owner->mixFrames(p_buffer, p_frames)) {
+        for (int32_t i = 0; i < p_frames; i++) {
+            p_buffer[i].left = 0.0f;
+            p_buffer[i].right = 0.0f;
+        }
+    }
+    return p_frames;
+}
+
+double GDSynthesizerStreamPlayback::_get_stream_sampling_rate() const
+{
+    return stream->mixRate;
+}
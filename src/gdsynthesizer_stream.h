@@ -0,0 +1,82 @@
+/**************************************************************************/
+/*  gdsynthesizer_stream.h                                                */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#ifndef GDSYNTHESIZER_STREAM_H
+#define GDSYNTHESIZER_STREAM_H
+#include <godot_cpp/classes/audio_stream.hpp>
+#include <godot_cpp/classes/audio_stream_playback_resampled.hpp>
+#include <godot_cpp/classes/audio_frame.hpp>
+#include <mutex>
+
+namespace godot {
+
+class GDSynthesizer;
+
+// AudioStream pulled by the audio server's mixer thread.
+// It has no data of its own, the playback renders from the owner GDSynthesizer.
+class GDSynthesizerStream : public AudioStream {
+    GDCLASS(GDSynthesizerStream, AudioStream);
+    friend class GDSynthesizerStreamPlayback;
+
+    std::mutex ownerMutex; // guards owner against the node's destruction while mixing.
+    GDSynthesizer *owner = nullptr;
+    double mixRate = 44100.0;
+protected:
+    static void _bind_methods();
+public:
+    void setOwner(GDSynthesizer *p_owner, double p_mix_rate);
+
+    virtual Ref<AudioStreamPlayback> _instantiate_playback() const override;
+    virtual String _get_stream_name() const override;
+    virtual double _get_length() const override;
+    virtual bool _is_monophonic() const override;
+};
+
+class GDSynthesizerStreamPlayback : public AudioStreamPlaybackResampled {
+    GDCLASS(GDSynthesizerStreamPlayback, AudioStreamPlaybackResampled);
+    friend class GDSynthesizerStream;
+
+    Ref<GDSynthesizerStream> stream;
+    bool active = false;
+protected:
+    static void _bind_methods();
+public:
+    virtual void _start(double p_from_pos) override;
+    virtual void _stop() override;
+    virtual bool _is_playing() const override;
+    virtual int32_t _get_loop_count() const override;
+    virtual double _get_playback_position() const override;
+    virtual void _seek(double p_position) override;
+
+    virtual int32_t _mix_resampled(AudioFrame *p_buffer, int32_t p_frames) override;
+    virtual double _get_stream_sampling_rate() const override;
+};
+}
+
+#endif // GDSYNTHESIZER_STREAM_H
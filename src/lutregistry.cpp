@@ -0,0 +1,187 @@
+/**************************************************************************/
+/*  lutregistry.cpp                                                       */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "lutregistry.hpp"
+#include "sequencer.hpp"
+
+std::mutex LUTRegistry::mutex;
+std::weak_ptr<const WaveTables> LUTRegistry::waves;
+std::map<float, std::weak_ptr<const SlopeTables>> LUTRegistry::slopes;
+std::map<std::array<float, 9>, std::weak_ptr<const BakedWave>> LUTRegistry::bakedWaves;
+
+std::shared_ptr<const WaveTables> LUTRegistry::getWaves(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto tables = waves.lock();
+    if (!tables) {
+        tables = makeWaves();
+        waves = tables;
+    }
+    return tables;
+}
+
+std::shared_ptr<const SlopeTables> LUTRegistry::getSlopes(float rate) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = slopes.begin(); it != slopes.end();) {
+        if (it->second.expired()) it = slopes.erase(it);
+        else it++;
+    }
+    auto tables = slopes[rate].lock();
+    if (!tables) {
+        tables = makeSlopes(rate);
+        slopes[rate] = tables;
+    }
+    return tables;
+}
+
+std::shared_ptr<const BakedWave> LUTRegistry::findBakedWave(const std::array<float, 9> &signature) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = bakedWaves.find(signature);
+    if (it == bakedWaves.end()) return nullptr;
+    return it->second.lock();
+}
+
+// another Sequencer may have baked same mix meanwhile, then its table is returned.
+std::shared_ptr<const BakedWave> LUTRegistry::keepBakedWave(const std::array<float, 9> &signature, std::shared_ptr<const BakedWave> baked) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = bakedWaves.begin(); it != bakedWaves.end();) {
+        if (it->second.expired()) it = bakedWaves.erase(it);
+        else it++;
+    }
+    auto kept = bakedWaves[signature].lock();
+    if (kept) return kept;
+    bakedWaves[signature] = baked;
+    return baked;
+}
+
+// number of tables alive now, waves, slopes par rate and baked waves.
+int32_t LUTRegistry::getLiveTables(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int32_t count = waves.expired() ? 0 : 1;
+    for (auto &slope : slopes) {
+        if (!slope.second.expired()) count++;
+    }
+    for (auto &baked : bakedWaves) {
+        if (!baked.second.expired()) count++;
+    }
+    return count;
+}
+
+std::shared_ptr<const WaveTables> LUTRegistry::makeWaves(void) {
+    auto tables = std::make_shared<WaveTables>();
+    auto &waveLUT = tables->wave;
+    int32_t s = WaveTables::size;
+    { // sin wave
+        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SIN);
+        for (int32_t i = 0; i < s; i++){
+            waveLUT[j][i] = sinf(2.0f*PI*(float)i/(float)s);
+        }
+    }
+    { // square wave
+        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SQUARE);
+        for (int32_t i = 0; i < s; i++){
+            waveLUT[j][i] = (i < s/2) ? 1.0f : -1.0f;
+        }
+    }
+    { // triangle wave
+        int32_t j = static_cast<int32_t>(BaseWave::WAVE_TRIANGLE);
+        for (int32_t i = 0; i < s; i++){
+            waveLUT[j][(i+3*s/4)%s] = (i < s/2)?((float)i*4.0f)/((float)s)-1.0f:3.0f-((float)i*4.0f)/((float)s);
+        }
+    }
+    { // sawtooth wave
+        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
+        for (int32_t i = 0; i < s; i++){
+            waveLUT[j][(i+3*s/4)%s] = ((float)i*2.0f)/((float)s)-1.0f;
+        }
+    }
+    { // sin on sawtooth2 wave
+        int32_t l = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
+        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SIN);
+        int32_t k = static_cast<int32_t>(BaseWave::WAVE_SINSAWx2);
+        for (int32_t i = 0; i < s; i++){
+            waveLUT[k][i] = ((waveLUT[j][i]+1.0f)+(waveLUT[l][(i*2)%s]+1.0f))/2.0f -1.0f;
+        }
+    }
+    { //make look-up table to convert velocity value to output power.
+        for (int32_t i = 0; i < 128; i++){
+            tables->velocity2power[i] = powf((float)(i+1)/128.0f, 2.2f);
+        }
+    }
+    return tables;
+}
+
+std::shared_ptr<const SlopeTables> LUTRegistry::makeSlopes(float samplingRate) {
+    auto tables = std::make_shared<SlopeTables>();
+    tables->samplingRate = samplingRate;
+    tables->decayHalfLifeTime = decayHalfLifeTime;
+    {
+        int32_t numAtackSlopeLUT = (int32_t)((1.0f/atackSlopeHz/2.0f)*samplingRate);
+        tables->atack.resize(numAtackSlopeLUT);
+        tables->atackTime = 1.0f/atackSlopeHz/2.0f*1000.0f;
+#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
+        godot::UtilityFunctions::print("numAtackSlopeLUT ", numAtackSlopeLUT);
+        godot::UtilityFunctions::print("atackSlopeTime ", tables->atackTime);
+#endif // DEBUG_ENABLED
+
+        for (int32_t i = 0; i < numAtackSlopeLUT; i++){
+            tables->atack[i] = (1.0f-cosf(PI*(float)i/(float)numAtackSlopeLUT))/2.0f;
+        }
+    }
+    {
+        int32_t numReleaseSlopeLUT = (int32_t)((1.0f/releaseSlopeHz/2.0f)*samplingRate);
+        tables->release.resize(numReleaseSlopeLUT);
+        tables->releaseTime = 1.0f/releaseSlopeHz/2.0f*1000.0f;
+#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
+        godot::UtilityFunctions::print("numReleaseSlopeLUT ", numReleaseSlopeLUT);
+        godot::UtilityFunctions::print("releaseSlopeTime ", tables->releaseTime);
+#endif // DEBUG_ENABLED
+        for (int32_t i = 0; i < numReleaseSlopeLUT; i++){
+            tables->release[i] = (1.0f+cosf(PI*(float)i/(float)numReleaseSlopeLUT))/2.0f;
+        }
+    }
+    {
+        int32_t numDecaySlopeLUT = (int32_t)((1.0f/decaySlopeHz/2.0f)*samplingRate);
+        tables->decay.resize(numDecaySlopeLUT);
+        float decaySlopeTime = tables->decayTime = 1.0f/decaySlopeHz/2.0f*1000.0f;
+#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
+        godot::UtilityFunctions::print("numDecaySlopeLUT ", numDecaySlopeLUT);
+        godot::UtilityFunctions::print("decaySlopeTime ", decaySlopeTime);
+#endif // DEBUG_ENABLED
+        auto &decaySlopeLUT = tables->decay;
+        for (int32_t i = 0; i < numDecaySlopeLUT; i++){
+            decaySlopeLUT[i] = 0.5f+tanhf(log10f(decayHalfLifeTime/(decaySlopeTime*(float)i/(float)numDecaySlopeLUT)))/2.0f;
+        }
+        float offset = decaySlopeLUT[numDecaySlopeLUT-1];
+        float range = 1.0f - offset;
+        for (int32_t i = 0; i < numDecaySlopeLUT; i++){
+            decaySlopeLUT[i] = (decaySlopeLUT[i]-offset)/range;
+        }
+    }
+    return tables;
+}
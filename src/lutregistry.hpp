@@ -0,0 +1,94 @@
+/**************************************************************************/
+/*  lutregistry.hpp                                                       */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#ifndef LUTREGISTRY_H
+#define LUTREGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// base waves and velocity curve, same for every sampling rate.
+struct WaveTables {
+    static constexpr int32_t size = 32768;
+    static constexpr int32_t numWaves = 5; // BaseWave::WAVE_TAIL.
+    float wave[numWaves][size];
+    float velocity2power[128];
+};
+
+// envelope slopes, their length in samples depends on the sampling rate.
+struct SlopeTables {
+    float samplingRate;
+    std::vector<float> atack;
+    std::vector<float> release;
+    std::vector<float> decay;
+    float atackTime; // msec.
+    float releaseTime;
+    float decayTime;
+    float decayHalfLifeTime;
+};
+
+// mix of 3 oscillators baked into one table for one phase.
+// sample is base[i] + key*slope[i], where key lerps each base wave to sin wave.
+struct BakedWave{
+    int32_t reference;  // oscillator whose phase is used for the table.
+    std::unique_ptr<float []> base;
+    std::unique_ptr<float []> slope;
+    mutable std::atomic<int32_t> users {0};  // tones playing it, counted by the render side of any Sequencer.
+};
+
+// process wide cache of the read only look-up tables.
+// tables are made on first use and shared by every Sequencer holding them,
+// they are freed when the last holder drops its pointer.
+// baked waves are looked up by the signature of their mix, see Sequencer::bakeInstrument().
+class LUTRegistry {
+private:
+    static constexpr float atackSlopeHz = 25.0f;
+    static constexpr float releaseSlopeHz = 25.0f;
+    static constexpr float decaySlopeHz = 1.0f;
+    static constexpr float decayHalfLifeTime = 50.0f;
+    static std::mutex mutex;
+    static std::weak_ptr<const WaveTables> waves;
+    static std::map<float, std::weak_ptr<const SlopeTables>> slopes;
+    static std::map<std::array<float, 9>, std::weak_ptr<const BakedWave>> bakedWaves;
+    static std::shared_ptr<const WaveTables> makeWaves(void);
+    static std::shared_ptr<const SlopeTables> makeSlopes(float);
+public:
+    static std::shared_ptr<const WaveTables> getWaves(void);
+    static std::shared_ptr<const SlopeTables> getSlopes(float);
+    static std::shared_ptr<const BakedWave> findBakedWave(const std::array<float, 9> &);
+    static std::shared_ptr<const BakedWave> keepBakedWave(const std::array<float, 9> &, std::shared_ptr<const BakedWave>);
+    static int32_t getLiveTables(void);
+};
+
+#endif // LUTREGISTRY_H
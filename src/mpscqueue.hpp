@@ -0,0 +1,93 @@
+/**************************************************************************/
+/*  mpscqueue.hpp                                                         */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// bounded lock-free queue of POD records, any thread may push and one thread pops.
+// each cell has a sequence number that tells whether it is free or filled for the lap.
+template <class T>
+class MpscQueue {
+private:
+    struct Cell {
+        std::atomic<int64_t> sequence;
+        T data;
+    };
+    std::unique_ptr<Cell[]> cells;
+    int64_t mask;
+    alignas(64) std::atomic<int64_t> enqueuePos {0};
+    alignas(64) int64_t dequeuePos = 0;
+public:
+    explicit MpscQueue(int64_t size) {
+        int64_t capacity = 1;
+        while (capacity < size) capacity <<= 1;
+        mask = capacity - 1;
+        cells = std::make_unique<Cell[]>(capacity);
+        for (int64_t i = 0; i < capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    // producer side, returns false when full.
+    bool push(const T &value) {
+        int64_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = cells[pos & mask];
+            int64_t dif = cell.sequence.load(std::memory_order_acquire) - pos;
+            if (dif == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (dif < 0) {
+                return false;
+            }
+            else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    // consumer side, returns false when empty.
+    bool pop(T &value) {
+        Cell &cell = cells[dequeuePos & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+            return false;
+        }
+        value = cell.data;
+        cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+};
+
+#endif // MPSCQUEUE_H
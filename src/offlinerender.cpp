@@ -0,0 +1,134 @@
+/**************************************************************************/
+/*  offlinerender.cpp                                                     */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "offlinerender.hpp"
+#include <chrono>
+#include <cstring>
+
+bool OfflineRender::prepare(Sequencer &sequencer, double rate, const std::function<bool(Sequencer &)> &prepare) {
+    sequencer.initParam(rate, blockFrames/rate, blockFrames);
+    if (!prepare(sequencer)) {
+        return false;
+    }
+    godot::Dictionary once;
+    once["loop"] = false;
+    sequencer.setSlotParams(0, once);
+    return true;
+}
+
+OfflineRender::Stats OfflineRender::render(Sequencer &sequencer, double rate, double seconds, const std::function<void(const float *, int32_t)> &sink) {
+    Stats stats;
+    int64_t limit = (int64_t)(std::clamp(seconds > 0.0 ? seconds : maxSeconds, 0.0, maxSeconds)*rate);
+    auto bus = std::make_unique<float[]>(blockFrames*2);
+    auto begin = std::chrono::steady_clock::now();
+    while (stats.frames < limit) {
+        sequencer.feed(bus.get());
+        int32_t frames = (int32_t)std::min((int64_t)blockFrames, limit - stats.frames);
+        for (int32_t i = 0; i < frames*2; i++) {
+            bus[i] = std::clamp(bus[i], -1.0f, 1.0f);
+            stats.peak = std::max(stats.peak, std::fabs(bus[i]));
+        }
+        sink(bus.get(), frames);
+        stats.frames += frames;
+        if (sequencer.isFinished()) { // silence till the end of track and release tails are kept.
+            stats.isEnded = true;
+            break;
+        }
+    }
+    stats.usec = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    stats.realtimeFactor = (stats.usec > 0.0) ? ((double)stats.frames/rate)/(stats.usec/1000000.0) : 0.0;
+    return stats;
+}
+
+bool OfflineRender::isValidBits(int32_t bits) {
+    return bits == 16 || bits == 24 || bits == 32;
+}
+
+static void putLE(uint8_t *dst, uint32_t value, int32_t bytes) {
+    for (int32_t i = 0; i < bytes; i++) dst[i] = (uint8_t)(value >> (i*8));
+}
+
+int32_t OfflineRender::wavHeaderSize(int32_t bits) {
+    return (bits == 32) ? 58 : 44;
+}
+
+// data larger than 4GB is not supported by RIFF, sizes are saturated.
+// non PCM format needs cbSize in fmt and a fact chunk of the frames, strict readers refuse it without them.
+void OfflineRender::makeWavHeader(uint8_t *header, int32_t rate, int32_t bits, int64_t frames) {
+    const int32_t channels = 2;
+    bool isFloat = (bits == 32);
+    int32_t size = wavHeaderSize(bits);
+    int32_t blockAlign = channels*bits/8;
+    uint32_t dataSize = (uint32_t)std::min(frames*blockAlign, (int64_t)0xffffffffLL - (size - 8));
+    std::memcpy(header, "RIFF", 4);
+    putLE(header + 4, dataSize + (size - 8), 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    putLE(header + 16, isFloat ? 18 : 16, 4);
+    putLE(header + 20, isFloat ? 3 : 1, 2); // 3 is IEEE float, 1 is PCM.
+    putLE(header + 22, channels, 2);
+    putLE(header + 24, (uint32_t)rate, 4);
+    putLE(header + 28, (uint32_t)(rate*blockAlign), 4);
+    putLE(header + 32, blockAlign, 2);
+    putLE(header + 34, bits, 2);
+    uint8_t *data = header + 36;
+    if (isFloat) {
+        putLE(header + 36, 0, 2); // cbSize.
+        std::memcpy(header + 38, "fact", 4);
+        putLE(header + 42, 4, 4);
+        putLE(header + 46, dataSize/blockAlign, 4);
+        data = header + 50;
+    }
+    std::memcpy(data, "data", 4);
+    putLE(data + 4, dataSize, 4);
+}
+
+// returns bytes written, dst has frames*2*bits/8 bytes.
+int64_t OfflineRender::encodeFrames(const float *src, int32_t frames, int32_t bits, uint8_t *dst) {
+    int32_t samples = frames*2;
+    if (bits == 16) {
+        for (int32_t i = 0; i < samples; i++) {
+            int32_t v = (int32_t)std::lrint(std::clamp(src[i], -1.0f, 1.0f)*32767.0f);
+            putLE(dst + i*2, (uint32_t)v, 2);
+        }
+        return (int64_t)samples*2;
+    }
+    if (bits == 24) {
+        for (int32_t i = 0; i < samples; i++) {
+            int32_t v = (int32_t)std::lrint((double)std::clamp(src[i], -1.0f, 1.0f)*8388607.0);
+            putLE(dst + i*3, (uint32_t)v, 3);
+        }
+        return (int64_t)samples*3;
+    }
+    for (int32_t i = 0; i < samples; i++) {
+        uint32_t v;
+        std::memcpy(&v, &src[i], sizeof(v));
+        putLE(dst + i*4, v, 4);
+    }
+    return (int64_t)samples*4;
+}
@@ -0,0 +1,63 @@
+/**************************************************************************/
+/*  offlinerender.hpp                                                     */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#ifndef OFFLINERENDER_H
+#define OFFLINERENDER_H
+
+#include <cstdint>
+#include <functional>
+
+#include "sequencer.hpp"
+
+// renders a Sequencer as fast as the cpu can, without the audio server.
+// the smf of slot 0 is played once, and rendering stops at its end of track, after its last tone is silent.
+class OfflineRender {
+public:
+    static constexpr int32_t blockFrames = 1024;
+    static constexpr double maxSeconds = 3600.0;
+    static constexpr int32_t maxWavHeaderSize = 58;
+    struct Stats {
+        int64_t frames = 0;
+        double usec = 0.0;            // wall time of rendering.
+        double realtimeFactor = 0.0;  // seconds of sound par second of rendering.
+        float peak = 0.0f;
+        bool isEnded = false;         // false when stopped by the length.
+    };
+    // sequencer is initialized for rate here, then bank and smf are set by prepare.
+    static bool prepare(Sequencer &, double rate, const std::function<bool(Sequencer &)> &prepare);
+    // seconds 0 is until the end of the smf. sink gets clipped interleaved stereo par block.
+    static Stats render(Sequencer &, double rate, double seconds, const std::function<void(const float *, int32_t)> &sink);
+    static bool isValidBits(int32_t bits);
+    // 16 and 24 bits are PCM with 44 bytes header, 32 bits is IEEE float with 18 bytes fmt and a fact chunk.
+    static int32_t wavHeaderSize(int32_t bits);
+    static void makeWavHeader(uint8_t *header, int32_t rate, int32_t bits, int64_t frames);
+    static int64_t encodeFrames(const float *src, int32_t frames, int32_t bits, uint8_t *dst);
+};
+
+#endif // OFFLINERENDER_H
@@ -0,0 +1,86 @@
+/**************************************************************************/
+/*  pcmring.hpp                                                           */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef PCMRING_H
+#define PCMRING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// single producer single consumer ring of interleaved stereo frames.
+// the producer only writes writePos and the consumer only writes readPos.
+class PcmRing {
+private:
+    std::unique_ptr<float[]> buf;
+    int64_t capacity = 0; // frames, power of 2.
+    int64_t mask = 0;
+    alignas(64) std::atomic<int64_t> writePos {0};
+    alignas(64) std::atomic<int64_t> readPos {0};
+public:
+    // not thread safe, call while neither side runs.
+    void init(int64_t frames) {
+        capacity = 1;
+        while (capacity < frames) capacity <<= 1;
+        mask = capacity - 1;
+        buf = std::make_unique<float[]>(capacity*2);
+        writePos.store(0, std::memory_order_relaxed);
+        readPos.store(0, std::memory_order_relaxed);
+    }
+    int64_t getCapacity(void) const {return capacity;}
+    int64_t readable(void) const {
+        return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_relaxed);
+    }
+    int64_t writable(void) const {
+        return capacity - (writePos.load(std::memory_order_relaxed) - readPos.load(std::memory_order_acquire));
+    }
+    // producer side.
+    int64_t write(const float* src, int64_t frames) {
+        int64_t w = writePos.load(std::memory_order_relaxed);
+        int64_t n = std::min(frames, capacity - (w - readPos.load(std::memory_order_acquire)));
+        int64_t head = std::min(n, capacity - (w & mask));
+        std::memcpy(&buf[(w & mask)*2], src, sizeof(float)*2*head);
+        std::memcpy(&buf[0], src + head*2, sizeof(float)*2*(n - head));
+        writePos.store(w + n, std::memory_order_release);
+        return n;
+    }
+    // consumer side.
+    int64_t read(float* dst, int64_t frames) {
+        int64_t r = readPos.load(std::memory_order_relaxed);
+        int64_t n = std::min(frames, writePos.load(std::memory_order_acquire) - r);
+        int64_t head = std::min(n, capacity - (r & mask));
+        std::memcpy(dst, &buf[(r & mask)*2], sizeof(float)*2*head);
+        std::memcpy(dst + head*2, &buf[0], sizeof(float)*2*(n - head));
+        readPos.store(r + n, std::memory_order_release);
+        return n;
+    }
+};
+
+#endif // PCMRING_H
@@ -1,6 +1,7 @@
 #include "register_types.h"
 
 #include "gdsynthesizer.h"
+#include "gdsynthesizer_stream.h"
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/defs.hpp>
@@ -15,6 +16,8 @@ void initialize_gdsynthesizer_module(ModuleInitializationLevel p_level)
         return;
     }
 
+    ClassDB::register_class<GDSynthesizerStream>();
+    ClassDB::register_class<GDSynthesizerStreamPlayback>();
     ClassDB::register_class<GDSynthesizer>();
 }
 
@@ -33,6 +33,7 @@
 #endif // DEBUG_ENABLED && WINDOWS_ENABLED
 
 #include "instrument.hpp"
+#include <cstddef> // for offsetof of packed bank words.
 
 const char* scale[] = {" C", "C#", " D", "D#", " E", " F", "F#", " G", "G#", " A", "A#", " B"};
 
@@ -56,19 +57,116 @@ float PinkNoise::makeNoise(float in) {
     return t;    
 }
 
+static inline uint32_t noiseHash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline float noiseFloat(uint32_t x) {
+    return (float)(int32_t)x * (1.0f/2147483648.0f); // [-1, 1)
+}
+
+// gain to normalize PinkNoise output to [-1, 1], measured once with one second of white noise.
+float NoiseGenerator::pinkGain(void) {
+    static const float gain = [](){
+        PinkNoise pink;
+        float max = 0.0f;
+        for (uint32_t i = 0; i < 44100; i++){
+            float v = std::abs(pink.makeNoise(noiseFloat(noiseHash(i))));
+            if (v > max) max = v;
+        }
+        return (max > 0.0f) ? 1.0f/max : 1.0f;
+    }();
+    return gain;
+}
+
+void NoiseGenerator::reset(uint32_t givenSeed) {
+    seed = noiseHash(givenSeed*0x9e3779b9u + 1u);
+    counter = 0;
+    pinkNoise = PinkNoise();
+    dcIn = dcOut = 0.0f;
+}
+
+// makes white noise and, when distributed is given, its distribution for frequency noise.
+void NoiseGenerator::makeNoise(float *white, float *distributed, int32_t n, NoiseDistributType type) {
+    uint32_t s1 = seed;
+    uint32_t s2 = seed ^ 0x5bd1e995u;
+    uint32_t c = counter;
+    for (int32_t k = 0; k < n; k++){
+        white[k] = noiseFloat(noiseHash((c + (uint32_t)k) ^ s1));
+    }
+    if (distributed != nullptr) {
+        if (type == NoiseDistributType::NOISEDTYPE_TRIANGULAR) {
+            for (int32_t k = 0; k < n; k++){
+                float r = std::abs(white[k]);
+                distributed[k] = noiseFloat(noiseHash((c + (uint32_t)k) ^ s2))*r;
+            }
+        }
+        else if (type == NoiseDistributType::NOISEDTYPE_COS4ThPOW) {
+            for (int32_t k = 0; k < n; k++){
+                float r = std::abs(white[k]);
+                float r2 = r*r;
+                // sin(r*PI/2) that is equal to cos(PI*(r/2-1/2)).
+                float sn = r*(1.5707963f - r2*(0.6459641f - r2*(0.0796926f - r2*0.0046818f)));
+                sn *= sn;
+                distributed[k] = noiseFloat(noiseHash((c + (uint32_t)k) ^ s2))*(1.0f - sn*sn);
+            }
+        }
+        else {
+            for (int32_t k = 0; k < n; k++) distributed[k] = white[k];
+        }
+    }
+    counter += (uint32_t)n;
+}
+
+// pole is of the DC blocker, given for the sampling rate.
+void NoiseGenerator::makePink(float *pink, const float *white, int32_t n, float pole) {
+    float gain = pinkGain();
+    for (int32_t k = 0; k < n; k++){
+        float in = pinkNoise.makeNoise(white[k])*gain;
+        dcOut = in - dcIn + pole*dcOut;
+        dcIn = in;
+        pink[k] = std::clamp(dcOut, -1.0f, 1.0f);
+    }
+}
+
+// each Sequencer starts its note seeds from its own point, so nodes playing same notes do not sum same noise.
+static std::atomic<uint32_t> sequencerCount {0};
+
 Sequencer::Sequencer() {
-    rand = memnew(godot::RandomNumberGenerator);
+    noiseSeed = noiseHash(sequencerCount.fetch_add(1, std::memory_order_relaxed));
+    channelPan.fill(0.0f);
+    for (auto &level : masterLevels) level.store(0.0f);
+    for (auto &level : channelLevels) level.store(0.0f);
+    pendingCommands.reserve(commandQueueSize);
+    {
+        auto first = std::make_shared<InstrumentBank>(); // not baked until initParam().
+        first->instruments = defaultInstruments;
+        first->percussions = defaultPercussions;
+        publishBank(first);
+    }
+    for (auto &group : voiceGroups) group.reserve(numTone);
+    controlState.renderThreads = std::clamp((int32_t)std::thread::hardware_concurrency()/2 - 1, 0, 3);
+    voiceJob = [this](int32_t g, int32_t worker) {
+        if (voiceGroups[g].empty()) return;
+        float* bus = groupBus[g];
+        std::fill(bus, bus + bufferSamples*2, 0.0f);
+        for (Tone* tone : voiceGroups[g]) {
+            tone->isSounding = renderTone(*tone, bus, scratches[worker]);
+        }
+    };
 }
 
 Sequencer::~Sequencer(){
+    resetTones(); // borrowed buffers go back to the pool.
     for (int32_t i = 0; i < std::size(toneInstances); i++) {
         delete [] toneInstances[i].delayBuffer;
         toneInstances[i].delayBuffer = nullptr;
     }
-
-    if (rand) {
-        memdelete(rand);
-    }
 }
 
 float Sequencer::noteFrequency(int8_t note) {
@@ -76,24 +174,15 @@ float Sequencer::noteFrequency(int8_t note) {
 }
 
 float Sequencer::centFrequency(float freq, float cent) {
-    static const float h = (powf(2.0f,  120.0f/1200.0f)-1.0f)/120.0f;
-    static const float l = (powf(2.0f, -120.0f/1200.0f)-1.0f)/120.0f;
-    static const float t =  (float(pow2_x_1200LUT_size/2));
-    static const float b = -(float(pow2_x_1200LUT_size/2));
-
-    float result;
-    if      (cent <=        b) result = freq * pow2_x_1200LUT[0];
-    else if (cent <   -120.0f) result = freq * pow2_x_1200LUT[pow2_x_1200LUT_size/2+(int32_t)cent];
-    else if (cent <      0.0f) result = freq * (1.0f - cent*l);
-    else if (cent <=   120.0f) result = freq * (1.0f + cent*h);
-    else if (cent <         t) result = freq * pow2_x_1200LUT[pow2_x_1200LUT_size/2+(int32_t)cent];
-    else                       result = freq * pow2_x_1200LUT[pow2_x_1200LUT_size-1];
+    float result = freq * fastExp2(cent*(1.0f/1200.0f));
     if (result > samplingRate*0.47f) result = samplingRate*0.47f; // 0.47 is upper limit.
     return result;
 }
 
 godot::Array Sequencer::getInstruments(void) {
     godot::Array array;
+    std::lock_guard<std::mutex> lock(bankMutex);
+    const std::array<Instrument, numinstruments> &instruments = publishedBank->instruments;
     for (int32_t i = 0; i < 256; i++) {
         godot::Dictionary dic;
 
@@ -139,6 +228,9 @@ godot::Array Sequencer::getInstruments(void) {
         dic["amSync"]             = instruments[i].amSync;
         dic["amWave"]             = static_cast<int32_t>(instruments[i].amWave);
 
+        dic["pan"]                = instruments[i].pan;
+        dic["stereoSpread"]       = instruments[i].stereoSpread;
+
         array.push_back(dic);
     }
     return array;
@@ -151,61 +243,451 @@ void Sequencer::setInstruments(const godot::Array array) {
         godot::UtilityFunctions::print("Error in setInstruments(): array size error, ", array.size());
 #endif // DEBUG_ENABLED
     }
+    std::lock_guard<std::mutex> lock(bankMutex);
+    auto next = std::make_shared<InstrumentBank>(*publishedBank);
+    for (int32_t i = 0; i < std::min((int32_t)array.size(), numinstruments); i++) {
+        godot::Dictionary dic = array[i];
+        Instrument &instrument = next->instruments[i];
+
+        instrument.totalGain              = (float)(double)dic["totalGain"];
+        instrument.atackSlopeTime         = (float)(double)dic["atackSlopeTime"];
+        instrument.decayHalfLifeTime      = (float)(double)dic["decayHalfLifeTime"];
+        instrument.sustainRate            = (float)(double)dic["sustainRate"];
+        instrument.releaseSlopeTime       = (float)(double)dic["releaseSlopeTime"];
+
+        instrument.baseVsOthersRatio      = (float)(double)dic["baseVsOthersRatio"];
+        instrument.side1VsSide2Ratio      = (float)(double)dic["side1VsSide2Ratio"];
+        instrument.baseOffsetCent1        = (float)(double)dic["baseOffsetCent1"];
+        instrument.baseWave1              = static_cast<BaseWave>((int32_t)dic["baseWave1"]);
+        instrument.baseOffsetCent2        = (float)(double)dic["baseOffsetCent2"];
+        instrument.baseWave2              = static_cast<BaseWave>((int32_t)dic["baseWave2"]);
+        instrument.baseOffsetCent3        = (float)(double)dic["baseOffsetCent3"];
+        instrument.baseWave3              = static_cast<BaseWave>((int32_t)dic["baseWave3"]);
+
+        instrument.noiseRatio             = (float)(double)dic["noiseRatio"];
+        instrument.noiseColorType         = static_cast<NoiseColorType>((int32_t)dic["noiseColorType"]);
+
+        instrument.delay0Time             = (float)(double)dic["delay0Time"];
+        instrument.delay1Time             = (float)(double)dic["delay1Time"];
+        instrument.delay2Time             = (float)(double)dic["delay2Time"];
+        instrument.delay0Ratio            = (float)(double)dic["delay0Ratio"];
+        instrument.delay1Ratio            = (float)(double)dic["delay1Ratio"];
+        instrument.delay2Ratio            = (float)(double)dic["delay2Ratio"];
+
+        instrument.freqNoiseCentRange     = (float)(double)dic["freqNoiseCentRange"];
+        instrument.freqNoiseType          = static_cast<NoiseDistributType>((int32_t)dic["freqNoiseType"]);
+
+        instrument.fmCentRange            = (float)(double)dic["fmCentRange"];
+        instrument.fmFreq                 = (float)(double)dic["fmFreq"];
+        instrument.fmPhaseOffset          = (float)(double)dic["fmPhaseOffset"];
+        instrument.fmSync                 = (int32_t)dic["fmSync"];
+        instrument.fmWave                 = static_cast<BaseWave>((int32_t)dic["fmWave"]);
+
+        instrument.amLevel                = (float)(double)dic["amLevel"];
+        instrument.amFreq                 = (float)(double)dic["amFreq"];
+        instrument.amPhaseOffset          = (float)(double)dic["amPhaseOffset"];
+        instrument.amSync                 = (int32_t)dic["amSync"];
+        instrument.amWave                 = static_cast<BaseWave>((int32_t)dic["amWave"]);
+
+        instrument.pan                    = (float)(double)dic["pan"];
+        instrument.stereoSpread           = (float)(double)dic["stereoSpread"];
+        clampInstrument(instrument);
+        bakeInstrument(*next, i);
+    }
+    publishBank(next);
+}
+
+
+// same ranges for all ways to set instruments.
+void Sequencer::clampInstrument(Instrument &instrument) {
     int32_t WAVE_TAIL = static_cast<int32_t>(BaseWave::WAVE_TAIL)-1;
     int32_t NOISECTYPE_TAIL = static_cast<int32_t>(NoiseColorType::NOISECTYPE_TAIL)-1;
     int32_t NOISEDTYPE_TAIL = static_cast<int32_t>(NoiseDistributType::NOISEDTYPE_TAIL)-1;
-    for (int32_t i = 0; i < 256; i++) {
-        godot::Dictionary dic = array[i];
 
-        instruments[i].totalGain          = (float)(godot::Math::clamp((double)(dic["totalGain"]), 0.0, 1.0));
-        instruments[i].atackSlopeTime     = (float)(godot::Math::clamp((double)(dic["atackSlopeTime"]), 0.0, 5000.0));
-        instruments[i].decayHalfLifeTime  = (float)(godot::Math::clamp((double)(dic["decayHalfLifeTime"]), 0.0, 5000.0));
-        instruments[i].sustainRate        = (float)(godot::Math::clamp((double)(dic["sustainRate"]), 0.0, 1.0));
-        instruments[i].releaseSlopeTime   = (float)(godot::Math::clamp((double)(dic["releaseSlopeTime"]), 0.0, 5000.0));
-
-        instruments[i].baseVsOthersRatio  = (float)(godot::Math::clamp((double)(dic["baseVsOthersRatio"]), 0.0, 1.0));
-        instruments[i].side1VsSide2Ratio  = (float)(godot::Math::clamp((double)(dic["side1VsSide2Ratio"]), 0.0, 1.0));
-        instruments[i].baseOffsetCent1    = (float)(godot::Math::clamp((double)(dic["baseOffsetCent1"]), -8400.0, 8400.0));
-        instruments[i].baseWave1          = static_cast<BaseWave>(std::clamp((int32_t)dic["baseWave1"], 0, WAVE_TAIL));
-        instruments[i].baseOffsetCent2    = (float)(godot::Math::clamp((double)(dic["baseOffsetCent2"]), -8400.0, 8400.0));
-        instruments[i].baseWave2          = static_cast<BaseWave>(std::clamp((int32_t)dic["baseWave2"], 0, WAVE_TAIL));
-        instruments[i].baseOffsetCent3    = (float)(godot::Math::clamp((double)(dic["baseOffsetCent3"]), -8400.0, 8400.0));
-        instruments[i].baseWave3          = static_cast<BaseWave>(std::clamp((int32_t)dic["baseWave3"], 0, WAVE_TAIL));
-
-        instruments[i].noiseRatio         = (float)(godot::Math::clamp((double)(dic["noiseRatio"]), 0.0, 1.0));
-        instruments[i].noiseColorType     = static_cast<NoiseColorType>(std::clamp((int32_t)dic["noiseColorType"], 0, NOISECTYPE_TAIL));
-
-        instruments[i].delay0Time         = (float)(godot::Math::clamp((double)(dic["delay0Time"]), 0.0, 500.0));
-        instruments[i].delay1Time         = (float)(godot::Math::clamp((double)(dic["delay1Time"]), 0.0, 500.0));
-        instruments[i].delay2Time         = (float)(godot::Math::clamp((double)(dic["delay2Time"]), 0.0, 500.0));
-        instruments[i].delay0Ratio        = (float)(godot::Math::clamp((double)(dic["delay0Ratio"]), 0.2, 0.2));
-        instruments[i].delay1Ratio        = (float)(godot::Math::clamp((double)(dic["delay1Ratio"]), 0.2, 0.2));
-        instruments[i].delay2Ratio        = (float)(godot::Math::clamp((double)(dic["delay2Ratio"]), 0.2, 0.2));
-
-        instruments[i].freqNoiseCentRange = (float)(godot::Math::clamp((double)(dic["freqNoiseCentRange"]), -8400.0, 8400.0));
-        instruments[i].freqNoiseType      = static_cast<NoiseDistributType>(std::clamp((int32_t)dic["freqNoiseType"], 0, NOISEDTYPE_TAIL));
-
-        instruments[i].fmCentRange        = (float)(godot::Math::clamp((double)(dic["fmCentRange"]), -8400.0, 8400.0));
-        instruments[i].fmFreq             = (float)(godot::Math::clamp((double)(dic["fmFreq"]), 0.0, 7040.0));
-        instruments[i].fmPhaseOffset      = (float)(godot::Math::clamp((double)(dic["fmPhaseOffset"]), 0.0, 2.0));
-        if (instruments[i].fmPhaseOffset == 2.0f) instruments[i].fmPhaseOffset = 0.0f;
-        
-        instruments[i].fmSync             = (int32_t)(std::clamp((int32_t)dic["fmSync"], 0, 1));
-        instruments[i].fmWave             = static_cast<BaseWave>(std::clamp((int32_t)dic["fmWave"], 0, WAVE_TAIL));
+    instrument.totalGain              = godot::Math::clamp(instrument.totalGain, 0.0f, 1.0f);
+    instrument.atackSlopeTime         = godot::Math::clamp(instrument.atackSlopeTime, 0.0f, 5000.0f);
+    instrument.decayHalfLifeTime      = godot::Math::clamp(instrument.decayHalfLifeTime, 0.0f, 5000.0f);
+    instrument.sustainRate            = godot::Math::clamp(instrument.sustainRate, 0.0f, 1.0f);
+    instrument.releaseSlopeTime       = godot::Math::clamp(instrument.releaseSlopeTime, 0.0f, 5000.0f);
+
+    instrument.baseVsOthersRatio      = godot::Math::clamp(instrument.baseVsOthersRatio, 0.0f, 1.0f);
+    instrument.side1VsSide2Ratio      = godot::Math::clamp(instrument.side1VsSide2Ratio, 0.0f, 1.0f);
+    instrument.baseOffsetCent1        = godot::Math::clamp(instrument.baseOffsetCent1, -8400.0f, 8400.0f);
+    instrument.baseWave1              = static_cast<BaseWave>(std::clamp(static_cast<int32_t>(instrument.baseWave1), 0, WAVE_TAIL));
+    instrument.baseOffsetCent2        = godot::Math::clamp(instrument.baseOffsetCent2, -8400.0f, 8400.0f);
+    instrument.baseWave2              = static_cast<BaseWave>(std::clamp(static_cast<int32_t>(instrument.baseWave2), 0, WAVE_TAIL));
+    instrument.baseOffsetCent3        = godot::Math::clamp(instrument.baseOffsetCent3, -8400.0f, 8400.0f);
+    instrument.baseWave3              = static_cast<BaseWave>(std::clamp(static_cast<int32_t>(instrument.baseWave3), 0, WAVE_TAIL));
+
+    instrument.noiseRatio             = godot::Math::clamp(instrument.noiseRatio, 0.0f, 1.0f);
+    instrument.noiseColorType         = static_cast<NoiseColorType>(std::clamp(static_cast<int32_t>(instrument.noiseColorType), 0, NOISECTYPE_TAIL));
+
+    instrument.delay0Time             = godot::Math::clamp(instrument.delay0Time, 0.0f, 500.0f);
+    instrument.delay1Time             = godot::Math::clamp(instrument.delay1Time, 0.0f, 500.0f);
+    instrument.delay2Time             = godot::Math::clamp(instrument.delay2Time, 0.0f, 500.0f);
+    instrument.delay0Ratio            = godot::Math::clamp(instrument.delay0Ratio, 0.2f, 0.2f);
+    instrument.delay1Ratio            = godot::Math::clamp(instrument.delay1Ratio, 0.2f, 0.2f);
+    instrument.delay2Ratio            = godot::Math::clamp(instrument.delay2Ratio, 0.2f, 0.2f);
+
+    instrument.freqNoiseCentRange     = godot::Math::clamp(instrument.freqNoiseCentRange, -8400.0f, 8400.0f);
+    instrument.freqNoiseType          = static_cast<NoiseDistributType>(std::clamp(static_cast<int32_t>(instrument.freqNoiseType), 0, NOISEDTYPE_TAIL));
+
+    instrument.fmCentRange            = godot::Math::clamp(instrument.fmCentRange, -8400.0f, 8400.0f);
+    instrument.fmFreq                 = godot::Math::clamp(instrument.fmFreq, 0.0f, 7040.0f);
+    instrument.fmPhaseOffset          = godot::Math::clamp(instrument.fmPhaseOffset, 0.0f, 2.0f);
+    if (instrument.fmPhaseOffset == 2.0f) instrument.fmPhaseOffset = 0.0f;
+    instrument.fmSync                 = std::clamp(instrument.fmSync, 0, 1);
+    instrument.fmWave                 = static_cast<BaseWave>(std::clamp(static_cast<int32_t>(instrument.fmWave), 0, WAVE_TAIL));
+
+    instrument.amLevel                = godot::Math::clamp(instrument.amLevel, 0.0f, 1.0f);
+    instrument.amFreq                 = godot::Math::clamp(instrument.amFreq, 0.0f, 7040.0f);
+    instrument.amPhaseOffset          = godot::Math::clamp(instrument.amPhaseOffset, 0.0f, 2.0f);
+    if (instrument.amPhaseOffset == 2.0f) instrument.amPhaseOffset = 0.0f;
+    instrument.amSync                 = std::clamp(instrument.amSync, 0, 1);
+    instrument.amWave                 = static_cast<BaseWave>(std::clamp(static_cast<int32_t>(instrument.amWave), 0, WAVE_TAIL));
+
+    instrument.pan                    = godot::Math::clamp(instrument.pan, -1.0f, 1.0f);
+    instrument.stereoSpread           = godot::Math::clamp(instrument.stereoSpread, 0.0f, 1.0f);
+}
+
+
+// words of Instrument holding enum or int, they are stored as float of the value in packed bank.
+// taken from offsetof, so a reorder of Instrument moves them too.
+static constexpr int32_t intWords[] = {
+    offsetof(Instrument, baseWave1)/sizeof(float),
+    offsetof(Instrument, baseWave2)/sizeof(float),
+    offsetof(Instrument, baseWave3)/sizeof(float),
+    offsetof(Instrument, noiseColorType)/sizeof(float),
+    offsetof(Instrument, freqNoiseType)/sizeof(float),
+    offsetof(Instrument, fmSync)/sizeof(float),
+    offsetof(Instrument, fmWave)/sizeof(float),
+    offsetof(Instrument, amSync)/sizeof(float),
+    offsetof(Instrument, amWave)/sizeof(float),
+};
+static constexpr bool isIntWord(int32_t word) {
+    for (int32_t w : intWords) {
+        if (w == word) return true;
+    }
+    return false;
+}
+static_assert(sizeof(Instrument) == sizeof(float)*35, "Instrument must be 35 words without padding");
+static_assert(sizeof(BaseWave) == 4 && sizeof(NoiseColorType) == 4 && sizeof(NoiseDistributType) == 4, "enums must be 32bit");
+
+
+// instrumentStride floats par instrument in field order of Instrument.
+godot::PackedFloat32Array Sequencer::getInstrumentsPacked(void) {
+    godot::PackedFloat32Array packed;
+    packed.resize((int64_t)numinstruments*instrumentStride);
+    float *dst = packed.ptrw();
+    std::lock_guard<std::mutex> lock(bankMutex);
+    for (int32_t i = 0; i < numinstruments; i++) {
+        const Instrument &instrument = publishedBank->instruments[i];
+        for (int32_t w = 0; w < instrumentStride; w++) {
+            int32_t word;
+            std::memcpy(&word, reinterpret_cast<const char*>(&instrument) + w*4, 4);
+            if (isIntWord(w)) dst[w] = (float)word;
+            else std::memcpy(&dst[w], &word, 4);
+        }
+        dst += instrumentStride;
+    }
+    return packed;
+}
+
+
+// updates instruments from first with whole records in data, only they are baked again.
+// returns number of updated instruments.
+int32_t Sequencer::setInstrumentsPacked(const float *data, int64_t size, int32_t first) {
+    if (first < 0 || first >= numinstruments) {
+        return 0;
+    }
+    int32_t count = (int32_t)std::min(size/instrumentStride, (int64_t)(numinstruments - first));
+    if (count <= 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(bankMutex);
+    auto next = std::make_shared<InstrumentBank>(*publishedBank);
+    for (int32_t i = 0; i < count; i++) {
+        const float *src = data + (int64_t)i*instrumentStride;
+        Instrument &instrument = next->instruments[first + i];
+        for (int32_t w = 0; w < instrumentStride; w++) {
+            int32_t word;
+            if (isIntWord(w)) word = (int32_t)std::clamp(src[w], -65536.0f, 65536.0f);
+            else std::memcpy(&word, &src[w], 4);
+            std::memcpy(reinterpret_cast<char*>(&instrument) + w*4, &word, 4);
+        }
+        clampInstrument(instrument);
+        bakeInstrument(*next, first + i);
+    }
+    publishBank(next);
+    return count;
+}
+
+
+// increased on each publish, for dirty check of editors.
+uint64_t Sequencer::getInstrumentVersion(void) const {
+    return bankVersion.load(std::memory_order_acquire);
+}
+
+
+static uint32_t fnv1a(const uint8_t *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i])*16777619u;
+    }
+    return hash;
+}
+
+
+// an instrument is valid when it has no NaN or inf and is in the ranges of clampInstrument(),
+// except delay ratios which set_synthe_params() pins to 0.2, a bank may hold any 0 to 1 as the defaults do.
+bool Sequencer::isValidInstrument(const Instrument &instrument) {
+    for (int32_t w = 0; w < instrumentStride; w++) {
+        if (isIntWord(w)) continue;
+        float value;
+        std::memcpy(&value, reinterpret_cast<const char*>(&instrument) + w*4, 4);
+        if (!std::isfinite(value)) return false;
+    }
+    float delayRatios = instrument.delay0Ratio + instrument.delay1Ratio + instrument.delay2Ratio;
+    if (instrument.delay0Ratio < 0.0f || instrument.delay1Ratio < 0.0f || instrument.delay2Ratio < 0.0f || delayRatios > 1.0f) {
+        return false;
+    }
+    Instrument clamped = instrument;
+    clampInstrument(clamped);
+    clamped.delay0Ratio = instrument.delay0Ratio;
+    clamped.delay1Ratio = instrument.delay1Ratio;
+    clamped.delay2Ratio = instrument.delay2Ratio;
+    return std::memcmp(&clamped, &instrument, sizeof(Instrument)) == 0;
+}
+
+
+// whole bank in .gdsbank layout, as it is in use, so a saved bank sounds same when it is loaded.
+godot::PackedByteArray Sequencer::getBankBytes(void) {
+    godot::PackedByteArray bytes;
+    bytes.resize(bankFileSize);
+    getBankBytes(bytes.ptrw());
+    return bytes;
+}
+
+
+// dst has bankFileSize bytes.
+void Sequencer::getBankBytes(uint8_t *dst) {
+    constexpr size_t instrumentsSize = sizeof(Instrument)*numinstruments;
+    constexpr size_t percussionsSize = sizeof(Percussion)*numPercussions;
+    uint8_t *body = dst + sizeof(BankFileHeader);
+    {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        std::memcpy(body, publishedBank->instruments.data(), instrumentsSize);
+        std::memcpy(body + instrumentsSize, publishedBank->percussions.data(), percussionsSize);
+    }
+    BankFileHeader header = {{'G', 'D', 'S', 'B'}, bankFileVersion,
+                             (uint32_t)numinstruments, (uint32_t)sizeof(Instrument),
+                             (uint32_t)numPercussions, (uint32_t)sizeof(Percussion),
+                             fnv1a(body, instrumentsSize + percussionsSize), 0};
+    std::memcpy(dst, &header, sizeof(BankFileHeader));
+}
+
+
+// replaces the whole bank with .gdsbank bytes. nothing is changed when any check fails.
+bool Sequencer::setBankBytes(const uint8_t *data, int64_t size) {
+    constexpr size_t instrumentsSize = sizeof(Instrument)*numinstruments;
+    constexpr size_t percussionsSize = sizeof(Percussion)*numPercussions;
+    if (data == nullptr || size != bankFileSize) {
+        return false;
+    }
+    BankFileHeader header;
+    std::memcpy(&header, data, sizeof(BankFileHeader));
+    if (std::memcmp(header.magic, "GDSB", 4) != 0 || header.version != bankFileVersion
+     || header.numInstruments != (uint32_t)numinstruments || header.instrumentSize != sizeof(Instrument)
+     || header.numPercussions != (uint32_t)numPercussions || header.percussionSize != sizeof(Percussion)) {
+#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
+        godot::UtilityFunctions::print("Error in setBankBytes(): header mismatch, version ", header.version);
+#endif // DEBUG_ENABLED
+        return false;
+    }
+    const uint8_t *body = data + sizeof(BankFileHeader);
+    if (fnv1a(body, instrumentsSize + percussionsSize) != header.checksum) {
+        return false;
+    }
+    auto next = std::make_shared<InstrumentBank>();
+    std::memcpy(next->instruments.data(), body, instrumentsSize);
+    std::memcpy(next->percussions.data(), body + instrumentsSize, percussionsSize);
+    for (const auto &instrument : next->instruments) {
+        if (!isValidInstrument(instrument)) return false;
+    }
+    for (const auto &percussion : next->percussions) {
+        if (percussion.program < 0 || percussion.program > 255 || percussion.key < 0 || percussion.key > 127) return false;
+    }
+    std::lock_guard<std::mutex> lock(bankMutex);
+    next->isBaked = publishedBank->isBaked;
+    for (int32_t i = 0; i < numinstruments; i++) bakeInstrument(*next, i); // same mixes reuse cached tables.
+    publishBank(next);
+    return true;
+}
+
+
+// the bank in use of source as it is, with its baking, so an offline render sounds as the playback.
+// baked tables do not depend on the sampling rate, so they are shared as they are.
+void Sequencer::copyBank(Sequencer &source) {
+    std::shared_ptr<InstrumentBank> next;
+    {
+        std::lock_guard<std::mutex> lock(source.bankMutex);
+        next = std::make_shared<InstrumentBank>(*source.publishedBank);
+    }
+    std::lock_guard<std::mutex> lock(bankMutex);
+    publishBank(next);
+}
+
+
+// caller holds bankMutex.
+void Sequencer::publishBank(std::shared_ptr<InstrumentBank> next) {
+    next->version = bankVersion.load(std::memory_order_relaxed) + 1;
+    if (publishedBank != nullptr) retiredBanks.push_back(std::move(publishedBank));
+    publishedBank = std::move(next);
+    nextBank.store(publishedBank.get());
+    bankVersion.store(publishedBank->version, std::memory_order_release);
+    trimRetiredBanks();
+}
+
+
+// caller holds bankMutex. a retired bank is freed once the render side does not hold it,
+// its baked waves that tones still play are kept until their users become 0.
+// tones take baked waves only from the bank in use, so a wave of a bank let go is counted already.
+void Sequencer::trimRetiredBanks(void) {
+    const InstrumentBank* inUse = bankInUse.load();
+    for (auto &one : retiredBanks) {
+        if (one.get() == inUse) continue;
+        for (const auto &baked : one->bakedWaves) {
+            if (baked == nullptr || baked->users.load() == 0) continue;
+            if (std::find(retiredWaves.begin(), retiredWaves.end(), baked) == retiredWaves.end()) retiredWaves.push_back(baked);
+        }
+        one = nullptr;
+    }
+    retiredBanks.erase(std::remove(retiredBanks.begin(), retiredBanks.end(), nullptr), retiredBanks.end());
+    retiredWaves.erase(std::remove_if(retiredWaves.begin(), retiredWaves.end(), [](const auto &baked) {
+        return baked->users.load() == 0;
+    }), retiredWaves.end());
+}
+
+
+// render side, a new bank is loaded only when its version is changed.
+// bankInUse is stored before the pointer is checked again, so the control side never frees a bank taken here.
+void Sequencer::pickUpBank(void) {
+    if (bank != nullptr && bank->version == bankVersion.load(std::memory_order_acquire)) {
+        return;
+    }
+    const InstrumentBank* next = nextBank.load();
+    do {
+        bank = next;
+        bankInUse.store(bank);
+        next = nextBank.load();
+    } while (next != bank);
+}
+
+
+// render side, users of the wave are counted while a tone plays it, nullptr lets it go.
+void Sequencer::setBakedWave(Tone &tone, const BakedWave* baked) {
+    if (baked != nullptr) baked->users.fetch_add(1);
+    if (tone.baked != nullptr) tone.baked->users.fetch_sub(1);
+    tone.baked = baked;
+}
+
+
+// bakes an instrument whose oscillators are octaves apart into one table.
+// FM and frequency noise scale all oscillators with same ratio, so their mix is still a function of one phase.
+// caller holds bankMutex, tables are shared through LUTRegistry by same mixes of any Sequencer.
+// only target, the unpublished next bank, is written. waveLUT is read only and isSet is written by initParam() alone.
+void Sequencer::bakeInstrument(InstrumentBank &target, int32_t i) {
+    int32_t s = waveLUTSize;
+    int32_t sinWave = static_cast<int32_t>(BaseWave::WAVE_SIN);
+    target.bakedWaves[i] = nullptr;
+    if (!target.isBaked || !isSet) return;
+    {
+        const Instrument &inst = target.instruments[i];
+        const float cents[3] = {inst.baseOffsetCent1, inst.baseOffsetCent2, inst.baseOffsetCent3};
+        const int32_t waves[3] = {static_cast<int32_t>(inst.baseWave1), static_cast<int32_t>(inst.baseWave2), static_cast<int32_t>(inst.baseWave3)};
+        const float ratios[3] = {
+            inst.baseVsOthersRatio,
+            (1.0f-inst.baseVsOthersRatio)*inst.side1VsSide2Ratio,
+            (1.0f-inst.baseVsOthersRatio)*(1.0f-inst.side1VsSide2Ratio)
+        };
+        int32_t reference = -1;
+        for (int32_t k = 0; k < 3; k++) {
+            if (ratios[k] != 0.0f && (reference < 0 || cents[k] < cents[reference])) reference = k;
+        }
+        if (reference < 0) return;
+
+        int32_t multiple[3] = {1, 1, 1};
+        bool isOctave = true;
+        for (int32_t k = 0; k < 3; k++) {
+            if (ratios[k] == 0.0f) continue;
+            float octave = (cents[k] - cents[reference])/1200.0f;
+            if (octave != floorf(octave)) isOctave = false;
+            else multiple[k] = 1 << (int32_t)octave;
+        }
+        if (!isOctave) return;
+
+        std::array<float, 9> signature = {
+            (float)waves[0], (float)waves[1], (float)waves[2],
+            cents[0], cents[1], cents[2],
+            ratios[0], ratios[1], ratios[2]
+        };
+        std::shared_ptr<const BakedWave> baked = LUTRegistry::findBakedWave(signature);
+        if (baked == nullptr) {
+            auto table = std::make_shared<BakedWave>();
+            table->reference = reference;
+            table->base = std::make_unique<float[]>(s);
+            table->slope = std::make_unique<float[]>(s);
+            double c = 1.0/120.0; // same as lerp to sin wave in feed().
+            for (int32_t x = 0; x < s; x++) {
+                double base = 0.0;
+                double slope = 0.0;
+                for (int32_t k = 0; k < 3; k++) {
+                    if (ratios[k] == 0.0f) continue;
+                    int32_t j = (x*multiple[k]) & (s - 1);
+                    double f = (double)waveLUT[sinWave][j];
+                    double g = (double)waveLUT[waves[k]][j];
+                    double offset = (double)(int32_t)(cents[k]/100.0f);
+                    base  += (double)ratios[k]*(g + (f - g)*offset*c);
+                    slope += (double)ratios[k]*(f - g)*c;
+                }
+                table->base[x] = (float)base;
+                table->slope[x] = (float)slope;
+            }
+            baked = LUTRegistry::keepBakedWave(signature, table);
+        }
+        target.bakedWaves[i] = baked;
+    }
+}
 
-        instruments[i].amLevel            = (float)(godot::Math::clamp((double)(dic["amLevel"]), 0.0, 1.0));
-        instruments[i].amFreq             = (float)(godot::Math::clamp((double)(dic["amFreq"]), 0.0, 7040.0));
-        instruments[i].amPhaseOffset      = (float)(godot::Math::clamp((double)(dic["amPhaseOffset"]), 0.0, 2.0));
-        if (instruments[i].amPhaseOffset == 2.0f) instruments[i].amPhaseOffset = 0.0f;
 
-        instruments[i].amSync             = (int32_t)(std::clamp((int32_t)dic["amSync"], 0, 1));
-        instruments[i].amWave             = static_cast<BaseWave>(std::clamp((int32_t)dic["amWave"], 0, WAVE_TAIL));
+// selects baked wave for the tone if its mix is same as 3 oscillators at its key.
+bool Sequencer::useBakedWave(Tone &tone) {
+    const BakedWave* baked = bank->bakedWaves[tone.program].get();
+    setBakedWave(tone, nullptr);
+    if (baked == nullptr) return false;
+
+    const float ratios[3] = {tone.base1ratio, tone.base2ratio, tone.base3ratio};
+    const float increments[3] = {tone.baseIncrement1, tone.baseIncrement2, tone.baseIncrement3};
+    const int32_t realKeys[3] = {tone.realKey1, tone.realKey2, tone.realKey3};
+    // lerp to sin wave must not be clamped and no oscillator may hit the upper limit of frequency.
+    float headroom = fastExp2((std::max(tone.instrument.fmCentRange, 0.0f) + 2.0f*std::abs(tone.freqNoiseCentharfRange))*(1.0f/1200.0f));
+    for (int32_t k = 0; k < 3; k++) {
+        if (ratios[k] == 0.0f) continue;
+        if (realKeys[k] < 0 || realKeys[k] > 120 || increments[k]*headroom >= maxIncrement) {
+            return false;
+        }
     }
+    setBakedWave(tone, baked);
+    tone.baseIncrement1 = increments[tone.baked->reference];
+    tone.bakedKey = (float)tone.key;
+    return true;
 }
 
 
 godot::Array Sequencer::getPercussions(void) {
     godot::Array array;
+    std::lock_guard<std::mutex> lock(bankMutex);
+    const std::array<Percussion, numPercussions> &percussions = publishedBank->percussions;
     for (int32_t i = 0; i < 128; i++) {
         godot::Dictionary dic;
 
@@ -223,25 +705,74 @@ void Sequencer::setPercussions(const godot::Array array) {
         godot::UtilityFunctions::print("Error in setPercussions(): array size error, ", array.size());
 #endif // DEBUG_ENABLED
     }
-    for (int32_t i = 0; i < 128; i++) {
+    std::lock_guard<std::mutex> lock(bankMutex);
+    auto next = std::make_shared<InstrumentBank>(*publishedBank); // baked waves are kept.
+    for (int32_t i = 0; i < std::min((int32_t)array.size(), numPercussions); i++) {
         godot::Dictionary dic = array[i];
-
-        percussions[i].program = (int32_t)(std::clamp((int32_t)dic["program"], 0, 255));
-        percussions[i].key     = (int32_t)(std::clamp((int32_t)dic["key"], 0, 127));
+        next->percussions[i].program = (int32_t)(std::clamp((int32_t)dic["program"], 0, 255));
+        next->percussions[i].key     = (int32_t)(std::clamp((int32_t)dic["key"], 0, 127));
     }
+    publishBank(next);
 }
 
 
 void Sequencer::setControlParams(const godot::Dictionary dic){
-    asumedConcurrentTone = (float)(godot::Math::clamp((double)(dic["divisionNum"]), 0.1, 64.0));
-    logLevel = (int32_t)(std::clamp((int32_t)dic["logLevel"], 0, 10));
-    maxValue = 0.0;
+    Command command;
+    command.type = CommandType::CT_CONTROL_PARAMS;
+    command.sampleTime = -1;
+    command.control.divisionNum = (float)(godot::Math::clamp((double)(dic["divisionNum"]), 0.1, 64.0));
+    command.control.logLevel = (int32_t)(std::clamp((int32_t)dic["logLevel"], 0, 10));
+    command.control.controlPeriod = 0;
+    if (dic.has("controlPeriod")) command.control.controlPeriod = (int32_t)(std::clamp((int32_t)dic["controlPeriod"], 1, maxControlPeriod));
+    command.control.renderThreads = -1;
+    if (dic.has("renderThreads")) command.control.renderThreads = (int32_t)(std::clamp((int32_t)dic["renderThreads"], 0, maxRenderThreads));
+    command.control.channelMeters = -1;
+    if (dic.has("channelMeters")) command.control.channelMeters = (bool)dic["channelMeters"] ? 1 : 0;
+    command.control.parallelVoices = 0;
+    if (dic.has("parallelVoices")) command.control.parallelVoices = (int32_t)(std::clamp((int32_t)dic["parallelVoices"], 1, numTone + 1));
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        if (pushCommand(command)) {
+            controlState.divisionNum = command.control.divisionNum;
+            controlState.logLevel = command.control.logLevel;
+            if (command.control.controlPeriod > 0) controlState.controlPeriod = command.control.controlPeriod;
+            if (command.control.parallelVoices > 0) controlState.parallelVoices = command.control.parallelVoices;
+            if (command.control.channelMeters >= 0) controlState.channelMeters = command.control.channelMeters;
+        }
+        if (command.control.renderThreads >= 0) {
+            controlState.renderThreads = command.control.renderThreads;
+            publishWorkers();
+        }
+    }
+
+    // baking is a property of the bank, so it is published as a new bank.
+    if (dic.has("bakeInstruments")) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        if (publishedBank != nullptr && publishedBank->isBaked != (bool)dic["bakeInstruments"]) {
+            auto next = std::make_shared<InstrumentBank>(*publishedBank);
+            next->isBaked = (bool)dic["bakeInstruments"];
+            for (int32_t i = 0; i < numinstruments; i++) bakeInstrument(*next, i);
+            publishBank(next);
+        }
+    }
 }
 
+// the control side copy, so own settings are read back before the render side has applied them.
 godot::Dictionary Sequencer::getControlParams(void) {
     godot::Dictionary dic;
-    dic["divisionNum"] = asumedConcurrentTone;
-    dic["logLevel"] = logLevel;
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        dic["divisionNum"] = controlState.divisionNum;
+        dic["logLevel"] = controlState.logLevel;
+        dic["controlPeriod"] = controlState.controlPeriod;
+        dic["renderThreads"] = controlState.renderThreads;
+        dic["parallelVoices"] = controlState.parallelVoices;
+        dic["channelMeters"] = controlState.channelMeters == 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        dic["bakeInstruments"] = (publishedBank != nullptr) ? publishedBank->isBaked : true;
+    }
     return dic;
 }
 
@@ -249,244 +780,510 @@ bool Sequencer::initParam(double rate, double time, int32_t samples) {
     samplingRate = (float)rate;
     bufferingTime = (float)time;
     bufferSamples = samples;
+    samplesParMsec = samplingRate/1000.0f;
+    dcBlockPole = expf(-2.0f*PI*dcBlockHz/samplingRate);
+    unitOfTime = rate*60.0;
+    for (auto &slot : slots) {
+        if (slot.midi != nullptr) slot.midi->setUnitOfTime(unitOfTime/slot.tempoScale);
+        slot.origin = 0;
+    }
     currentTime = 0;
-    frameCount = 0;
-    noiseBufSize = (int32_t)(rate/(double)bufferSamples);
-    noiseBuffer = bufferSamples*noiseBufSize;
-    freeTones.clear();
-    activeTones.clear();
-
     {
-        numAtackSlopeLUT = (int32_t)((1.0f/atackSlopeHz/2.0f)*samplingRate);
-        atackSlopeLUT = std::make_unique<float[]>(numAtackSlopeLUT);
-        atackSlopeTime = 1.0f/atackSlopeHz/2.0f*1000.0f;
-#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-        godot::UtilityFunctions::print("numAtackSlopeLUT ", numAtackSlopeLUT);
-        godot::UtilityFunctions::print("atackSlopeTime ", atackSlopeTime);
-#endif // DEBUG_ENABLED
-
-        for (int32_t i = 0; i < numAtackSlopeLUT; i++){
-            atackSlopeLUT[i] = (1.0f-cosf(PI*(float)i/(float)numAtackSlopeLUT))/2.0f;
-        }
+        std::lock_guard<std::mutex> lock(controlMutex);
+        publishWorkers();
     }
-    {
-        numReleaseSlopeLUT = (int32_t)((1.0f/releaseSlopeHz/2.0f)*samplingRate);
-        releaseSlopeLUT = std::make_unique<float[]>(numReleaseSlopeLUT);
-        releaseSlopeTime = 1.0f/releaseSlopeHz/2.0f*1000.0f;
-#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-        godot::UtilityFunctions::print("numReleaseSlopeLUT ", numReleaseSlopeLUT);
-        godot::UtilityFunctions::print("releaseSlopeTime ", releaseSlopeTime);
-#endif // DEBUG_ENABLED
-        for (int32_t i = 0; i < numReleaseSlopeLUT; i++){
-            releaseSlopeLUT[i] = (1.0f+cosf(PI*(float)i/(float)numReleaseSlopeLUT))/2.0f;
-        }
+    pickUpWorkers();
+    for (auto &scratch : scratches) {
+        scratch.envelope   = std::make_unique<float[]>(bufferSamples);
+        scratch.whiteNoise = std::make_unique<float[]>(bufferSamples);
+        scratch.pinkNoise  = std::make_unique<float[]>(bufferSamples);
+        scratch.freqNoise  = std::make_unique<float[]>(bufferSamples);
     }
     {
-        numDecaySlopeLUT = (int32_t)((1.0f/decaySlopeHz/2.0f)*samplingRate);
-        decaySlopeLUT = std::make_unique<float[]>(numDecaySlopeLUT);
-        decaySlopeTime = 1.0f/decaySlopeHz/2.0f*1000.0f;
-#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-        godot::UtilityFunctions::print("numDecaySlopeLUT ", numDecaySlopeLUT);
-        godot::UtilityFunctions::print("decaySlopeTime ", decaySlopeTime);
-#endif // DEBUG_ENABLED
-        for (int32_t i = 0; i < numDecaySlopeLUT; i++){
-            decaySlopeLUT[i] = 0.5f+tanhf(log10f(decayHalfLifeTime/(decaySlopeTime*(float)i/(float)numDecaySlopeLUT)))/2.0f;
-        }
+        int32_t stride = (bufferSamples*2 + 15) & ~15; // 64 bytes.
+        groupBusStore = std::make_unique<float[]>(stride*numVoiceGroups + 16);
+        void* head = groupBusStore.get();
+        size_t space = sizeof(float)*(stride*numVoiceGroups + 16);
+        float* base = static_cast<float*>(std::align(64, sizeof(float)*stride*numVoiceGroups, head, space));
+        for (int32_t g = 0; g < numVoiceGroups; g++) groupBus[g] = base + stride*g;
+    }
+    slopeTables = LUTRegistry::getSlopes(samplingRate);
+    atackSlopeLUT = slopeTables->atack.data();
+    numAtackSlopeLUT = (int32_t)slopeTables->atack.size();
+    atackSlopeTime = slopeTables->atackTime;
+    releaseSlopeLUT = slopeTables->release.data();
+    numReleaseSlopeLUT = (int32_t)slopeTables->release.size();
+    releaseSlopeTime = slopeTables->releaseTime;
+    decaySlopeLUT = slopeTables->decay.data();
+    numDecaySlopeLUT = (int32_t)slopeTables->decay.size();
+    decaySlopeTime = slopeTables->decayTime;
+    decayHalfLifeTime = slopeTables->decayHalfLifeTime;
+
+    // make delay ring buffers, sized again for the rate on each call.
+    delayBufferSize = (int32_t)((float)rate*(delayBufferDuration/1000.0f));
+
+    for (int32_t i = 0; i < std::size(toneInstances); i++) {
+        delete [] toneInstances[i].delayBuffer;
+        toneInstances[i].delayBuffer = (voicePool == nullptr) ? new float[delayBufferSize] : nullptr;
     }
+    resetTones();
+
+    isSet = true;
     {
-        float offset = decaySlopeLUT[numDecaySlopeLUT-1];
-        float range = 1.0f - offset;
-        for (int32_t i = 0; i < numDecaySlopeLUT; i++){
-            decaySlopeLUT[i] = (decaySlopeLUT[i]-offset)/range;
-        }
+        std::lock_guard<std::mutex> lock(bankMutex);
+        auto next = std::make_shared<InstrumentBank>();
+        next->isBaked = publishedBank->isBaked;
+        next->instruments = defaultInstruments;
+        next->percussions = defaultPercussions;
+        for (int32_t i = 0; i < numinstruments; i++) bakeInstrument(*next, i);
+        publishBank(next);
     }
+    pickUpBank();
+    return true;
+}
 
-    // make base wave look-up tables.
-    int32_t s = waveLUTSize;
-    { // sin wave
-        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SIN);
-        for (int32_t i = 0; i < s; i++){
-            waveLUT[j][i] = sinf(2.0f*PI*(float)i/(float)s);
-        }
+
+// all tones are stopped and relinked as free, borrowed buffers go back to the pool and baked waves are let go.
+void Sequencer::resetTones(void) {
+    for (auto &tone : activeTones) {
+        if (voicePool != nullptr) voicePool->release(tone.delayBuffer);
+        setBakedWave(tone, nullptr);
     }
-    { // square wave
-        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SQUARE);
-        for (int32_t i = 0; i < s; i++){
-            waveLUT[j][i] = (i < s/2) ? 1.0f : -1.0f;
-        }
+    freeTones.clear();
+    activeTones.clear();
+    for (int32_t i = 0; i < std::size(toneInstances); i++) {
+        freeTones.push_back(toneInstances[i]);
     }
-    { // triangle wave
-        int32_t j = static_cast<int32_t>(BaseWave::WAVE_TRIANGLE);
-        for (int32_t i = 0; i < s; i++){
-            waveLUT[j][(i+3*s/4)%s] = (i < s/2)?((float)i*4.0f)/((float)s)-1.0f:3.0f-((float)i*4.0f)/((float)s);
-        }
+    activeVoices.store(0, std::memory_order_relaxed);
+}
+
+
+// caller keeps feed() from running. own buffers are freed while the pool is used.
+// the buffers of the pool must be as large as getDelayBufferSize().
+void Sequencer::setVoicePool(VoicePool* pool, int32_t priority) {
+    voicePriority = priority;
+    if (pool == voicePool) {
+        return;
     }
-    { // sawtooth wave
-        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
-        for (int32_t i = 0; i < s; i++){
-            waveLUT[j][(i+3*s/4)%s] = ((float)i*2.0f)/((float)s)-1.0f;
-        }
+    resetTones();
+    voicePool = pool;
+    for (int32_t i = 0; i < std::size(toneInstances); i++) {
+        delete [] toneInstances[i].delayBuffer;
+        toneInstances[i].delayBuffer = (voicePool == nullptr && delayBufferSize > 0) ? new float[delayBufferSize] : nullptr;
     }
-    { // sin on sawtooth2 wave
-        int32_t l = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
-        int32_t j = static_cast<int32_t>(BaseWave::WAVE_SIN);
-        int32_t k = static_cast<int32_t>(BaseWave::WAVE_SINSAWx2);
-        for (int32_t i = 0; i < s; i++){
-            waveLUT[k][i] = ((waveLUT[j][i]+1.0f)+(waveLUT[l][(i*2)%s]+1.0f))/2.0f -1.0f;
-        }
+    resetTones();
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        publishWorkers();
     }
+    pickUpWorkers();
+}
 
-    // make delay ring buffers
-    delayBufferSize = (int32_t)((float)rate*(delayBufferDuration/1000.0f));
 
-    for (int32_t i = 0; i < std::size(toneInstances); i++) {
-        toneInstances[i].delayBuffer = new float[delayBufferSize];
-        freeTones.push_back(toneInstances[i]);
-    }
+// control side, the render side takes the new pool at head of next frame.
+void Sequencer::setRenderThreads(int32_t threads) {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    controlState.renderThreads = std::clamp(threads, 0, maxRenderThreads);
+    publishWorkers();
+}
 
-    { // make look-up table for white-noise and noise distributions.
-        whiteNoiseLUT             = std::make_unique<float[]>(noiseBuffer);
-        triangularDistributionLUT = std::make_unique<float[]>(noiseBuffer);
-        cos4thPowDistributionLUT  = std::make_unique<float[]>(noiseBuffer);
-        for (int32_t i = 0; i < noiseBuffer ; i++){
-            whiteNoiseLUT[i] = (float)rand->randf_range(-1.0, 1.0); // randf_range() returns double.
-            double r = godot::Math::absf((double)whiteNoiseLUT[i]);
-            double c = godot::Math::absf(1-pow(cos(Math_PI*(r*0.5-0.5)), 4.0));
-            triangularDistributionLUT[i] = (float)rand->randf_range(-r, r);
-            cos4thPowDistributionLUT[i]  = (float)rand->randf_range(-c, c);
-        }
-    }
 
-    { // make look-up table for pink-noise
-        pinkNoiseLUT              = std::make_unique<float[]>(noiseBuffer);
-        PinkNoise pinkNoise = PinkNoise();
-        for (int32_t i = 0; i < noiseBuffer ; i++){
-            pinkNoiseLUT[i] = pinkNoise.makeNoise(whiteNoiseLUT[i]);
-        }
-        float head = pinkNoiseLUT[0];
-        float tail = pinkNoise.makeNoise(whiteNoiseLUT[0]);
-        float diff = (tail- head)/(float)noiseBuffer;
-        float max = -1.0f;
-        float min =  1.0f;
+// caller holds controlMutex. a player of SynthServer is already rendered on a worker of the server,
+// so it has no own workers. renderThreads is kept and they come back when it leaves the pool.
+int32_t Sequencer::getOwnWorkers(void) const {
+    return (voicePool != nullptr) ? 0 : controlState.renderThreads;
+}
 
-        for (int32_t i = 0; i < noiseBuffer ; i++){
-            pinkNoiseLUT[i] += diff*(float)i;
-            if (pinkNoiseLUT[i] > max) max = pinkNoiseLUT[i];
-            if (pinkNoiseLUT[i] < min) min = pinkNoiseLUT[i];
-        }
-        for (int32_t i = 0; i < noiseBuffer ; i++){
-            pinkNoiseLUT[i] = (pinkNoiseLUT[i] - min)/(max - min)*2.0f - 1.0f;
-        }
-    }
 
-    { // make look-up table for centFrequency function.
-        pow2_x_1200LUT  = std::make_unique<float[]>(pow2_x_1200LUT_size);
-        for (int32_t i = 0; i < pow2_x_1200LUT_size ; i++){
-            pow2_x_1200LUT[i] = powf(2.0f, (float)(i-pow2_x_1200LUT_size/2)/1200.0f);
-        }
+// caller holds controlMutex. a pool is made only when the number of workers is changed,
+// the old one is freed once the render side has picked up a later version.
+void Sequencer::publishWorkers(void) {
+    uint64_t used = usedWorkersVersion.load(std::memory_order_acquire);
+    retiredWorkers.erase(std::remove_if(retiredWorkers.begin(), retiredWorkers.end(),
+                                        [&](const auto &one) { return one.first < used; }), retiredWorkers.end());
+    int32_t count = getOwnWorkers();
+    if (ownWorkers != nullptr && ownWorkerCount == count) {
+        return;
     }
-    { //make look-up table to convert velocity value to output power.
-        velocity2powerLUT = std::make_unique<float[]>(128);
-        {
-            for (int32_t i = 0; i < 128; i++){
-                velocity2powerLUT[i] = powf((float)(i+1)/128.0f, 2.2f);
-            }
-        }
+    auto next = std::make_unique<WorkerPool>();
+    next->resize(count);
+    if (ownWorkers != nullptr) retiredWorkers.emplace_back(workersVersion.load(std::memory_order_relaxed), std::move(ownWorkers));
+    ownWorkers = std::move(next);
+    ownWorkerCount = count;
+    publishedWorkers.store(ownWorkers.get(), std::memory_order_release);
+    workersVersion.fetch_add(1, std::memory_order_release);
+}
+
+
+// render side, a new pool is taken only when its version is changed.
+void Sequencer::pickUpWorkers(void) {
+    uint64_t version = workersVersion.load(std::memory_order_acquire);
+    if (version == usedWorkersVersion.load(std::memory_order_relaxed)) {
+        return;
     }
+    workers = publishedWorkers.load(std::memory_order_acquire);
+    usedWorkersVersion.store(version, std::memory_order_release);
+}
 
-    instruments = defaultInstruments;
-    percussions = defaultPercussions;
 
-    isSet = true;
-    return true;
+// notes not played for the voice limit or the voice pool.
+int64_t Sequencer::getDroppedVoices(void) const {
+    return droppedVoices.load(std::memory_order_relaxed);
+}
+
+
+void Sequencer::setVoiceLimit(int32_t limit) {
+    voiceLimit.store(std::clamp(limit, 0, numTone), std::memory_order_relaxed);
+}
+
+
+int32_t Sequencer::getVoiceLimit(void) const {
+    return voiceLimit.load(std::memory_order_relaxed);
+}
+
+
+int32_t Sequencer::getActiveVoices(void) const {
+    return activeVoices.load(std::memory_order_relaxed);
 }
 
 
+int32_t Sequencer::getDelayBufferSize(void) const {
+    return delayBufferSize;
+}
+
+
+// all slots and tones are stopped at next frame.
 bool Sequencer::smfUnload(void) {
-    unitOfTime = 60000.0;
-    midi.setUnitOfTime(unitOfTime); // milliseconds
-    freeTones.clear();
-    activeTones.clear();
-    for (int32_t i = 0; i < std::size(toneInstances); i++) {
-        freeTones.push_back(toneInstances[i]);
-    }
+    return handOverSmf(-1, nullptr);
+}
 
-    midi.unload();
-    
+
+// only the slot is stopped, its ringing tones are released and others keep playing.
+bool Sequencer::smfUnload(int32_t slot) {
+    if (slot < 0 || slot >= numSlots) return false;
+    return handOverSmf(slot, nullptr);
+}
+
+
+// plays the loaded smf of the slot from its head at next frame, e.g. a jingle again.
+bool Sequencer::smfRestart(int32_t slot) {
+    if (slot < 0 || slot >= numSlots) return false;
+    std::lock_guard<std::mutex> lock(controlMutex);
+    if (slotStates[slot].smf == nullptr) return false;
+    Command command;
+    command.type = CommandType::CT_SLOT_RESTART;
+    command.slot.slot = slot;
+    return pushSlotCommand(command);
+}
+
+
+// render side. no slot is playing and no tone is ringing, a looping slot is never finished.
+// every smf is parsed and played till its end of track, and no tone is sounding.
+bool Sequencer::isFinished(void) const {
+    if (!activeTones.empty()) return false;
+    for (const auto &slot : slots) {
+        if (slot.midi == nullptr) continue;
+        if (!slot.midi->isEnded() || currentTime < slot.origin + slot.midi->getEndTime()) return false;
+    }
     return true;
 }
 
 
-bool Sequencer::smfLoad(const char *name, double givenUnitOfTime) {
-    currentTime = 0;
-    unitOfTime = (float)givenUnitOfTime;
+// the file is read and parsed here on the calling thread, the render side only takes the pointer at next frame.
+bool Sequencer::smfLoad(const char *name, int32_t slot) {
+    if (slot < 0 || slot >= numSlots) return false;
+    auto smf = std::make_unique<SMFParser>();
+    if (smf->load(name) == false) {
+        return false;
+    }
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-    godot::UtilityFunctions::print("unitOfTime ", unitOfTime);
+    godot::UtilityFunctions::print("smf file size: ", smf->filesize);
 #endif // DEBUG_ENABLED
+    return handOverSmf(slot, std::move(smf));
+}
 
-    midi.setUnitOfTime(unitOfTime); // milliseconds
-    if (midi.load(name) == false) {
+
+bool Sequencer::smfLoad(const godot::String &name, int32_t slot) {
+    if (slot < 0 || slot >= numSlots) return false;
+    auto smf = std::make_unique<SMFParser>();
+    if (smf->load(name) == false) {
         return false;
     }
-    
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-        godot::UtilityFunctions::print("smf file size: ", midi.filesize);
+    godot::UtilityFunctions::print("smf file size: ", smf->filesize);
 #endif // DEBUG_ENABLED
-    return true;
+    return handOverSmf(slot, std::move(smf));
 }
 
 
-bool Sequencer::smfLoad(const godot::String &name, double givenUnitOfTime) {
-    currentTime = 0;
-    unitOfTime = (float)givenUnitOfTime;
-#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-    godot::UtilityFunctions::print("unitOfTime ", unitOfTime);
-#endif // DEBUG_ENABLED
+// control side. smf nullptr unloads the slot, slot -1 is all slots.
+// the replaced smf is retired, not freed, as the render side plays it until it takes the command.
+bool Sequencer::handOverSmf(int32_t slot, std::unique_ptr<SMFParser> smf) {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    Command command;
+    command.type = (smf != nullptr) ? CommandType::CT_SLOT_LOAD : CommandType::CT_SLOT_UNLOAD;
+    command.slot.slot = slot;
+    command.slot.smf = smf.get();
+    if (!pushSlotCommand(command)) {
+        return false;
+    }
+    for (int32_t k = 0; k < numSlots; k++) {
+        if (slot >= 0 && k != slot) continue;
+        if (slotStates[k].smf != nullptr) retiredSmfs.emplace_back(slotSerial, std::move(slotStates[k].smf));
+    }
+    if (slot >= 0) slotStates[slot].smf = std::move(smf);
+    return true;
+}
 
-    midi.setUnitOfTime(unitOfTime); // milliseconds
-    if (midi.load(name) == false) {
+
+// caller holds controlMutex. retired smfs are freed here once the render side has passed their serial.
+bool Sequencer::pushSlotCommand(Command &command) {
+    uint64_t applied = appliedSlotSerial.load(std::memory_order_acquire);
+    retiredSmfs.erase(std::remove_if(retiredSmfs.begin(), retiredSmfs.end(),
+                                     [&](const auto &one) { return one.first <= applied; }), retiredSmfs.end());
+    command.sampleTime = -1;
+    command.slot.serial = slotSerial + 1;
+    if (!pushCommand(command)) {
         return false;
     }
-    
-#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-        godot::UtilityFunctions::print("smf file size: ", midi.filesize);
-#endif // DEBUG_ENABLED
+    slotSerial++;
     return true;
 }
 
 
+// volume and channelOffset apply at once, tempo (scale of the smf tempo) from next start of the slot.
+void Sequencer::setSlotParams(int32_t slot, const godot::Dictionary dic) {
+    if (slot < 0 || slot >= numSlots) return;
+    Command command;
+    command.type = CommandType::CT_SLOT_PARAMS;
+    command.slot.slot = slot;
+    command.slot.smf = nullptr;
+    command.slot.loop = dic.has("loop") ? ((bool)dic["loop"] ? 1 : 0) : -1;
+    command.slot.volume = dic.has("volume") ? godot::Math::clamp((float)(double)dic["volume"], 0.0f, 4.0f) : -1.0f;
+    command.slot.channelOffset = dic.has("channelOffset") ? godot::Math::clamp((int32_t)dic["channelOffset"], 0, numChannels - 1) : -1;
+    command.slot.tempo = dic.has("tempo") ? godot::Math::clamp((double)dic["tempo"], 0.1, 10.0) : 0.0;
+    std::lock_guard<std::mutex> lock(controlMutex);
+    if (!pushSlotCommand(command)) return;
+    SlotState &state = slotStates[slot];
+    if (command.slot.loop >= 0)          state.isLoop = (command.slot.loop == 1);
+    if (command.slot.volume >= 0.0f)     state.volume = command.slot.volume;
+    if (command.slot.channelOffset >= 0) state.channelOffset = command.slot.channelOffset;
+    if (command.slot.tempo > 0.0)        state.tempoScale = command.slot.tempo;
+}
+
+
+// "playing" is as of the last rendered frame.
+godot::Dictionary Sequencer::getSlotParams(int32_t slot) {
+    godot::Dictionary dic;
+    if (slot < 0 || slot >= numSlots) return dic;
+    std::lock_guard<std::mutex> lock(controlMutex);
+    const SlotState &state = slotStates[slot];
+    dic["loop"]          = state.isLoop;
+    dic["volume"]        = state.volume;
+    dic["channelOffset"] = state.channelOffset;
+    dic["tempo"]         = state.tempoScale;
+    dic["loaded"]        = state.smf != nullptr;
+    dic["playing"]       = state.smf != nullptr && (playingSlots.load(std::memory_order_relaxed) & (1u << slot)) != 0;
+    return dic;
+}
+
+
 void Sequencer::incertNoteOn(const godot::Dictionary dic){
-    Note oneNote;
-    oneNote.state     = NState::NS_ON_FOREVER;
-    oneNote.trackNum  = 0;
-    oneNote.channel   = (int32_t)(std::clamp((int32_t)dic["channel"], 0, 31));
-    oneNote.key       = (int32_t)(std::clamp((int32_t)dic["key"], 0, 127));
-    oneNote.velocity  = (int32_t)(std::clamp((int32_t)dic["velocity"], 0, 127));
-    oneNote.program   = (int32_t)(std::clamp((int32_t)dic["program"], 0, 255));
-    oneNote.startTick = 0;
-    oneNote.startTime = currentTime;
-    oneNote.tempo     = (int32_t)(std::clamp((int32_t)dic["tempo"], 1, 999));
-
-    checkNewNote(oneNote);
+    pushNote(CommandType::CT_NOTE_ON, (int64_t)dic.get("time", -1), // optional sample on getSampleClock().
+             (int32_t)dic["channel"], (int32_t)dic["key"], (int32_t)dic["velocity"], (int32_t)dic["program"], (int32_t)dic["tempo"]);
 };
 
 
 void Sequencer::incertNoteOff(const godot::Dictionary dic){
-    Note oneNote;
-    oneNote.state     = NState::NS_OFF;
-    oneNote.trackNum  = 0;
-    oneNote.channel   = (int32_t)(std::clamp((int32_t)dic["channel"], 0, 31));
-    oneNote.key       = (int32_t)(std::clamp((int32_t)dic["key"], 0, 127));
-    oneNote.velocity  = (int32_t)(std::clamp((int32_t)dic["velocity"], 0, 127));
-    oneNote.program   = (int32_t)(std::clamp((int32_t)dic["program"], 0, 255));
-    oneNote.startTick = 0;
-    oneNote.startTime = currentTime;
-    oneNote.tempo     = (int32_t)(std::clamp((int32_t)dic["tempo"], 1, 999));
-
-    checkNewNote(oneNote);
+    pushNote(CommandType::CT_NOTE_OFF, (int64_t)dic.get("time", -1), // optional sample on getSampleClock().
+             (int32_t)dic["channel"], (int32_t)dic["key"], (int32_t)dic["velocity"], (int32_t)dic["program"], (int32_t)dic["tempo"]);
 };
 
 
+// typed fast path without Dictionary lookups. time is sample on getSampleClock(), -1 is as soon as possible.
+void Sequencer::noteOn(int64_t time, int32_t channel, int32_t key, int32_t velocity, int32_t program){
+    pushNote(CommandType::CT_NOTE_ON, time, channel, key, velocity, program, liveTempo);
+}
+
+
+void Sequencer::noteOff(int64_t time, int32_t channel, int32_t key){
+    pushNote(CommandType::CT_NOTE_OFF, time, channel, key, 0, 0, liveTempo);
+}
+
+
+// records of noteRecordStride ints. time of a record is samples after the current clock,
+// so a batch keeps its own timing. returns number of records queued.
+int64_t Sequencer::submitNotes(const int32_t *records, int64_t count){
+    int64_t clock = sampleClock.load(std::memory_order_relaxed);
+    int64_t queued = 0;
+    for (int64_t i = 0; i < count; i++) {
+        const int32_t *one = records + i*noteRecordStride;
+        CommandType type = (one[5] != 0) ? CommandType::CT_NOTE_ON : CommandType::CT_NOTE_OFF;
+        int64_t time = (one[0] > 0) ? clock + one[0] : -1;
+        if (pushNote(type, time, one[1], one[2], one[3], one[4], liveTempo)) queued++;
+    }
+    return queued;
+}
+
+
+bool Sequencer::pushNote(CommandType type, int64_t time, int32_t channel, int32_t key, int32_t velocity, int32_t program, int32_t tempo){
+    Command command;
+    command.type          = type;
+    command.sampleTime    = time;
+    command.note.channel  = std::clamp(channel, 0, 31);
+    command.note.key      = std::clamp(key, 0, 127);
+    command.note.velocity = std::clamp(velocity, 0, 127);
+    command.note.program  = std::clamp(program, 0, 255);
+    command.note.tempo    = std::clamp(tempo, 1, 999);
+    return pushCommand(command);
+}
+
+
+// any thread. a full queue is reported and nothing is drained here, so the render side never waits for a caller.
+bool Sequencer::pushCommand(const Command &command){
+    if (commands.push(command)) {
+        return true;
+    }
+#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
+    godot::UtilityFunctions::print("command queue is full, dropped type ", static_cast<int32_t>(command.type));
+#endif // DEBUG_ENABLED
+    return false;
+}
+
+
+int64_t Sequencer::getSampleClock(void) const {
+    return sampleClock.load(std::memory_order_relaxed);
+}
+
+
+// heap order of pendingCommands, earliest on top.
+static bool isLaterCommand(const Command &a, const Command &b){
+    if (a.sampleTime != b.sampleTime) return a.sampleTime > b.sampleTime;
+    return (int32_t)(a.order - b.order) > 0;
+}
+
+
+// render side only. applies commands due in the next frame, later ones wait in pendingCommands.
+// only the due ones are popped, so notes scheduled far ahead cost nothing par frame.
+// when pendingCommands is full the rest waits in the queue, a command is never applied before its time,
+// and pushCommand() reports a full queue.
+void Sequencer::drainCommands(void){
+    if (!isSet) {
+        return;
+    }
+    pickUpBank();
+    pickUpWorkers();
+    int64_t frameHead = sampleClock.load(std::memory_order_relaxed);
+    int64_t frameEnd = frameHead + bufferSamples;
+    bool isFull = true;
+    while (isFull) {
+        Command command;
+        while (pendingCommands.size() < pendingCommands.capacity() && commands.pop(command)) {
+            command.order = commandOrder++;
+            pendingCommands.push_back(command);
+            std::push_heap(pendingCommands.begin(), pendingCommands.end(), isLaterCommand);
+        }
+        isFull = (pendingCommands.size() == pendingCommands.capacity());
+        bool isApplied = false;
+        while (!pendingCommands.empty() && pendingCommands.front().sampleTime < frameEnd) {
+            std::pop_heap(pendingCommands.begin(), pendingCommands.end(), isLaterCommand);
+            const Command &one = pendingCommands.back();
+            int32_t offset = (int32_t)std::clamp(one.sampleTime - frameHead, (int64_t)0, (int64_t)bufferSamples - 1);
+            applyCommand(one, offset);
+            pendingCommands.pop_back();
+            isApplied = true;
+        }
+        isFull = isFull && isApplied; // room was made, so due ones still in the queue are taken in.
+    }
+}
+
+
+void Sequencer::applyCommand(const Command &command, int32_t offset){
+    switch(command.type) {
+        case CommandType::CT_NOTE_ON:
+        case CommandType::CT_NOTE_OFF:
+            {
+                Note oneNote;
+                oneNote.state     = (command.type == CommandType::CT_NOTE_ON) ? NState::NS_ON_FOREVER : NState::NS_OFF;
+                oneNote.trackNum  = 0;
+                oneNote.channel   = command.note.channel;
+                oneNote.key       = command.note.key;
+                oneNote.velocity  = command.note.velocity;
+                oneNote.program   = command.note.program;
+                oneNote.startTick = 0;
+                oneNote.startTime = currentTime + offset;
+                oneNote.tempo     = command.note.tempo;
+                checkNewNote(oneNote, offset);
+            }
+            break;
+
+        case CommandType::CT_CONTROL_PARAMS:
+            {
+                asumedConcurrentTone = command.control.divisionNum;
+                logLevel = command.control.logLevel;
+                if (command.control.controlPeriod > 0) controlPeriod = command.control.controlPeriod;
+                if (command.control.parallelVoices > 0) parallelVoices = command.control.parallelVoices;
+                if (command.control.channelMeters >= 0) isChannelMeterEnabled = (command.control.channelMeters == 1);
+            }
+            break;
+
+        case CommandType::CT_SLOT_LOAD:
+            {
+                SequenceSlot &target = slots[command.slot.slot];
+                if (command.slot.slot == 0) channelPan.fill(0.0f);
+                target.midi = command.slot.smf;
+                target.midi->setUnitOfTime(unitOfTime/target.tempoScale); // samples
+                target.origin = currentTime;
+                appliedSlotSerial.store(command.slot.serial, std::memory_order_release);
+            }
+            break;
+
+        case CommandType::CT_SLOT_UNLOAD:
+            if (command.slot.slot < 0) {
+                channelPan.fill(0.0f);
+                stopTones();
+                for (auto &slot : slots) slot.midi = nullptr;
+            }
+            else {
+                slots[command.slot.slot].midi = nullptr;
+                for (auto &tone : activeTones) {
+                    if (tone.slot != command.slot.slot || tone.note.state == NState::NS_OFF) continue;
+                    tone.releaseAt = std::max(tone.clock, (int64_t)tone.startAt);
+                    tone.note.state = NState::NS_OFF;
+                }
+            }
+            appliedSlotSerial.store(command.slot.serial, std::memory_order_release);
+            break;
+
+        case CommandType::CT_SLOT_RESTART:
+            {
+                SequenceSlot &target = slots[command.slot.slot];
+                if (target.midi != nullptr) {
+                    target.midi->setUnitOfTime(unitOfTime/target.tempoScale);
+                    target.midi->restart();
+                    target.origin = currentTime;
+                }
+                appliedSlotSerial.store(command.slot.serial, std::memory_order_release);
+            }
+            break;
+
+        case CommandType::CT_SLOT_PARAMS:
+            {
+                SequenceSlot &target = slots[command.slot.slot];
+                if (command.slot.loop >= 0)          target.isLoop = (command.slot.loop == 1);
+                if (command.slot.volume >= 0.0f)     target.volume = command.slot.volume;
+                if (command.slot.channelOffset >= 0) target.channelOffset = command.slot.channelOffset;
+                if (command.slot.tempo > 0.0)        target.tempoScale = command.slot.tempo;
+                appliedSlotSerial.store(command.slot.serial, std::memory_order_release);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
 godot::Ref<godot::Image> Sequencer::getMiniWavePicture(const godot::Dictionary dic){
     int32_t size_x = dic["size_x"];
     int32_t size_y = dic["size_y"];
@@ -539,33 +1336,60 @@ godot::Ref<godot::Image> Sequencer::getMiniWavePicture(const godot::Dictionary d
 }
 
 
-bool Sequencer::checkNewNote(Note oneNote){
-    float durationTime = 0;
-    if (oneNote.state == NState::NS_ON_FOREVER) durationTime = FLOAT_LONGTIME;
+// render side. the event is dropped when the main thread does not read them.
+void Sequencer::postNoteEvent(int32_t onOff, const Tone &tone){
+    NoteEvent event;
+    event.onOff         = onOff;
+    event.trackNum      = tone.note.trackNum;
+    event.channel       = tone.note.channel;
+    event.velocity      = tone.note.velocity;
+    event.program       = tone.note.program;
+    event.key           = tone.note.key;
+    event.instrumentNum = tone.program;
+    event.key2          = tone.key;
+    if (noteEvents.push(event)) {
+        hasNewNoteEvents = true;
+    }
+    else {
+        droppedNoteEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+// main thread, single reader.
+bool Sequencer::popNoteEvent(NoteEvent &event){
+    return noteEvents.pop(event);
+}
+
+
+int64_t Sequencer::getDroppedNoteEvents(void) const {
+    return droppedNoteEvents.load(std::memory_order_relaxed);
+}
+
+
+// offset is sample in the frame given by a command, or -1 to derive it from startTime.
+// startTime is on the sample timeline, so smf notes are also placed at exact sample.
+bool Sequencer::checkNewNote(Note oneNote, int32_t offset, int32_t slot){
+    if (oneNote.state == NState::NS_CONTROL) {
+        if (oneNote.key == 10 && oneNote.channel >= 0 && oneNote.channel < numChannels) { // pan
+            channelPan[oneNote.channel] = std::clamp(((float)oneNote.velocity - 64.0f)/63.0f, -1.0f, 1.0f);
+        }
+        return true;
+    }
     auto ringingTone = std::find_if(activeTones.begin(), activeTones.end(), [&](const Tone &foundTone){ 
         return (   oneNote.key == foundTone.note.key 
                 && oneNote.channel == foundTone.note.channel
+                && slot == foundTone.slot
                 && foundTone.note.state != NState::NS_OFF);
     });
     if (oneNote.state == NState::NS_OFF) {
         if (ringingTone != activeTones.end()) {
-            ringingTone->mainteinDuration = (float)(oneNote.startTime - ringingTone->note.startTime);
+            int64_t length = std::clamp(oneNote.startTime - ringingTone->note.startTime, (int64_t)0, (int64_t)SAMPLE_LONGTIME - ringingTone->startAt);
+            ringingTone->releaseAt = ringingTone->startAt + length;
+            if (offset >= 0) ringingTone->releaseAt = std::max(ringingTone->clock + offset, (int64_t)ringingTone->startAt);
             ringingTone->note.state = NState::NS_OFF;
 
-            {
-                godot::Dictionary dic;
-
-                dic["msg"]                = (int32_t)0;
-                dic["onOff"]              = (int32_t)0;
-                dic["trackNum"]           = ringingTone->note.trackNum;
-                dic["channel"]            = ringingTone->note.channel;
-                dic["velocity"]           = ringingTone->note.velocity;
-                dic["program"]            = ringingTone->note.program;
-                dic["key"]                = ringingTone->note.key;
-                dic["instrumentNum"]      = ringingTone->program;
-                dic["key2"]               = ringingTone->key;
-                emitSignal(dic);
-            }
+            postNoteEvent(0, *ringingTone);
 
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
             if (logLevel > 1){
@@ -575,29 +1399,38 @@ bool Sequencer::checkNewNote(Note oneNote){
                         "  prog ", ringingTone->note.program,
                         "  key ", ringingTone->note.key,
                         "  scale ", scale[ringingTone->note.key%12],(uint16_t)(ringingTone->note.key / 12) - 1,
-                        "  end(ms) ", ringingTone->note.startTime
+                        "  end(smp) ", ringingTone->note.startTime
                 );
             }
 #endif // DEBUG_ENABLED
         }
-        else {
-            return false;
-        }
+        // else nothing to release, e.g. the note was dropped, and later events go on.
+    }
+    else if (freeTones.size() != 0 && (int32_t)activeTones.size() >= voiceLimit.load(std::memory_order_relaxed)) {
+        droppedVoices.fetch_add(1, std::memory_order_relaxed); // over the cpu budget of the server, only this note is lost.
     }
     else if (freeTones.size() != 0){
         auto tone = freeTones.begin();
+        if (voicePool != nullptr) {
+            tone->delayBuffer = voicePool->acquire(voicePriority);
+            if (tone->delayBuffer == nullptr) { // voice budget of the server is used up, later events go on.
+                droppedVoices.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
 
         tone->note = oneNote;
+        tone->slot = slot;
 
         tone->phase1 = tone->phase2 = tone->phase3 = 0.0f;
+        tone->pan = 2.0f; // out of range, so gains are made in the first frame.
         tone->key = oneNote.key;
         tone->frequency = noteFrequency(oneNote.key);
-        tone->passed = 0;
-        tone->waitDuration = (float)(oneNote.startTime - currentTime);
-
-        tone->mainteinDuration = durationTime;
-        tone->restartWaitDuration = FLOAT_LONGTIME;
-        tone->restartTempo_f = tone->tempo_f = (float)oneNote.tempo*1000.0f; // msec
+        tone->clock = 0;
+        tone->startAt = (int32_t)std::clamp(oneNote.startTime - currentTime, (int64_t)0, (int64_t)bufferSamples - 1);
+        if (offset >= 0) tone->startAt = offset;
+        tone->releaseAt = SAMPLE_LONGTIME;
+        tone->tempo_f = (float)oneNote.tempo/60.0f; // beats par second
 
         // select instrument
         if (tone->note.channel > 127 || tone->note.channel < 0) {
@@ -605,25 +1438,25 @@ bool Sequencer::checkNewNote(Note oneNote){
             godot::UtilityFunctions::print("invalid tone->note.channel ", tone->note.channel);
 #endif // DEBUG_ENABLED
             tone->program = 0;
-            tone->instrument = instruments[0];
+            tone->instrument = bank->instruments[0];
             tone->note.velocity = 0;
         }
         else if (tone->note.channel == 9  || tone->note.channel == 25) { // 9 is ch10 that is reserved for Percussions.
-            tone->program = percussions[tone->note.key].program;
-            tone->instrument = instruments[percussions[tone->note.key].program];
-            tone->key = percussions[tone->note.key].key;
-            tone->frequency = noteFrequency(percussions[tone->note.key].key);
+            tone->program = bank->percussions[tone->note.key].program;
+            tone->instrument = bank->instruments[bank->percussions[tone->note.key].program];
+            tone->key = bank->percussions[tone->note.key].key;
+            tone->frequency = noteFrequency(bank->percussions[tone->note.key].key);
         }
         else {
             if (oneNote.program >= 0x70  && oneNote.program < 0x80){ // Percussives and Sound effects.
-                tone->program = percussions[oneNote.program].program;
-                tone->instrument = instruments[percussions[oneNote.program].program];
-                tone->key = percussions[oneNote.program].key;
-                tone->frequency = noteFrequency(percussions[oneNote.program].key);
+                tone->program = bank->percussions[oneNote.program].program;
+                tone->instrument = bank->instruments[bank->percussions[oneNote.program].program];
+                tone->key = bank->percussions[oneNote.program].key;
+                tone->frequency = noteFrequency(bank->percussions[oneNote.program].key);
             }
             else{
                 tone->program = oneNote.program;
-                tone->instrument = instruments[oneNote.program];
+                tone->instrument = bank->instruments[oneNote.program];
             }
         }
         {
@@ -631,23 +1464,8 @@ bool Sequencer::checkNewNote(Note oneNote){
             tone->realKey2 = tone->key + (int32_t)(tone->instrument.baseOffsetCent2/100.0f);
             tone->realKey3 = tone->key + (int32_t)(tone->instrument.baseOffsetCent3/100.0f);
         }
-        {
-            godot::Dictionary dic;
-            dic["msg"]                = (int32_t)0;
-            dic["onOff"]              = (int32_t)1;
-            dic["trackNum"]           = tone->note.trackNum;
-            dic["channel"]            = tone->note.channel;
-            dic["velocity"]           = tone->note.velocity;
-            dic["program"]            = tone->note.program;
-            dic["key"]                = tone->note.key;
-            dic["instrumentNum"]      = tone->program;
-            dic["key2"]               = tone->key;
-            emitSignal(dic);
-        }
-        {
-            tone->restartVelocity_f = tone->velocity_f = velocity2powerLUT[tone->note.velocity];
-            tone->atackedStrengthfloor = 0.0f;
-        }
+        postNoteEvent(1, *tone);
+        tone->velocity_f = velocity2powerLUT[tone->note.velocity];
         tone->base1ratio = tone->instrument.baseVsOthersRatio;
         tone->base2ratio = (1.0f-tone->instrument.baseVsOthersRatio)*tone->instrument.side1VsSide2Ratio;
         tone->base3ratio = (1.0f-tone->instrument.baseVsOthersRatio)*(1.0f-tone->instrument.side1VsSide2Ratio);
@@ -660,7 +1478,7 @@ bool Sequencer::checkNewNote(Note oneNote){
                 tone->fmIncrement = (2.0f * PI * tone->instrument.fmFreq ) / samplingRate;
             }
             else{
-                tone->fmIncrement = (2.0f * PI * tone->instrument.fmFreq * tone->tempo_f / unitOfTime) / samplingRate;
+                tone->fmIncrement = (2.0f * PI * tone->instrument.fmFreq * tone->tempo_f) / samplingRate;
             }
         }
 
@@ -672,13 +1490,14 @@ bool Sequencer::checkNewNote(Note oneNote){
                 tone->amIncrement = (2.0f * PI * tone->instrument.amFreq ) / samplingRate;
             }
             else{
-                tone->amIncrement = (2.0f * PI * tone->instrument.amFreq * tone->tempo_f / unitOfTime) / samplingRate;
+                tone->amIncrement = (2.0f * PI * tone->instrument.amFreq * tone->tempo_f) / samplingRate;
             }
         }
 
         // variable freqNoise related.
         {
             tone->freqNoiseCentharfRange = tone->instrument.freqNoiseCentRange*0.5f;
+            tone->noise.reset(++noiseSeed);
             float c1 = centFrequency(tone->frequency, tone->instrument.baseOffsetCent1);
             float l1 = centFrequency(c1, -(tone->freqNoiseCentharfRange));
             tone->baseIncrement1  = (2.0f * PI * l1) / samplingRate;
@@ -692,6 +1511,18 @@ bool Sequencer::checkNewNote(Note oneNote){
             tone->baseIncrement3  = (2.0f * PI * l3) / samplingRate;
         }
 
+        useBakedWave(*tone);
+
+        // LFO slower than 1/8 of control rate is updated at control rate, others at every sample.
+        {
+            float controlRate = samplingRate/(float)controlPeriod;
+            float fmInc = (tone->instrument.fmCentRange != 0.0f) ? tone->fmIncrement : 0.0f;
+            float amInc = (tone->instrument.amLevel != 0.0f) ? tone->amIncrement : 0.0f;
+            float fastest = std::max(fmInc, amInc)*samplingRate/(2.0f*PI);
+            tone->controlPeriod = (fastest*8.0f < controlRate) ? controlPeriod : 1;
+            modulate(*tone);
+        }
+
         // init delay ring buffer
         tone->delayBufferIndex = 0;
         tone->delay0Index = tone->delay1Index = tone->delay2Index = 0;
@@ -734,9 +1565,10 @@ bool Sequencer::checkNewNote(Note oneNote){
         tone->atackSlopeRatio = atackSlopeTime/tone->instrument.atackSlopeTime;
         tone->decaySlopeRatio = decayHalfLifeTime/tone->instrument.decayHalfLifeTime;
         tone->releaseSlopeRatio = releaseSlopeTime/tone->instrument.releaseSlopeTime;
+        tone->strength = tone->atackedStrength = 0.0f;
+        setEnvelopeStage(*tone, EnvelopeStage::ES_WAIT);
 
-        activeTones.insert(activeTones.end(), *freeTones.begin());
-        freeTones.erase(freeTones.begin());
+        activeTones.splice(activeTones.end(), freeTones, tone); // relinked, the tone is not copied.
 
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
         if (logLevel > 1){
@@ -748,7 +1580,7 @@ bool Sequencer::checkNewNote(Note oneNote){
 //                "  tempo ", tone->tempo_f,
                 "  key ", tone->note.key,
                 "  scale ", scale[tone->note.key%12],(uint16_t)(tone->note.key / 12) - 1,
-                "  start(ms) ", tone->note.startTime,
+                "  start(smp) ", tone->note.startTime,
                 " ", activeTones.size(), ":", freeTones.size()
             );
         }
@@ -763,248 +1595,521 @@ bool Sequencer::checkNewNote(Note oneNote){
     return true;
 }
 
-bool Sequencer::feed(double *frame){
-    for (int i=0; i < bufferSamples; i++) frame[i] = 0.0;
+static int32_t slopeSamples(int32_t numLUT, float step) {
+    if (!(step < (float)(numLUT - 2))) return 0; // also catches inf made by zero slope time.
+    return (int32_t)((float)(numLUT - 2)/step) + 1;
+}
 
-    int32_t frameTime = (int32_t)(bufferingTime*1000.0f);
-    Note oneNote;
-    while(isSet) {
-        oneNote = midi.parse(currentTime + frameTime);
-        if (oneNote.state == NState::NS_END || oneNote.state == NState::NS_EMPTY) {
+void Sequencer::setEnvelopeStage(Tone &tone, EnvelopeStage stage) {
+    tone.envStage = stage;
+    tone.envLUT = nullptr;
+    tone.envPos = 0.0f;
+    tone.envStep = 0.0f;
+    tone.envScale = 0.0f;
+    tone.envBias = 0.0f;
+    switch (stage) {
+        case EnvelopeStage::ES_WAIT:
+            tone.envRemain = tone.startAt - tone.clock;
+            break;
+        case EnvelopeStage::ES_ATACK:
+            tone.envLUT = atackSlopeLUT;
+            tone.envStep = tone.atackSlopeRatio;
+            tone.envScale = 1.0f;
+            tone.envRemain = slopeSamples(numAtackSlopeLUT, tone.envStep);
+            if (tone.envRemain == 0) tone.strength = 1.0f; // no atack, starts with full strength.
+            break;
+        case EnvelopeStage::ES_DECAY:
+            tone.atackedStrength = tone.strength;
+            tone.envLUT = decaySlopeLUT;
+            tone.envStep = tone.decaySlopeRatio;
+            tone.envScale = tone.atackedStrength*(1.0f-tone.instrument.sustainRate);
+            tone.envBias = tone.atackedStrength*tone.instrument.sustainRate;
+            tone.envRemain = slopeSamples(numDecaySlopeLUT, tone.envStep);
             break;
+        case EnvelopeStage::ES_SUSTAIN:
+            tone.envBias = tone.strength = tone.atackedStrength*tone.instrument.sustainRate;
+            tone.envRemain = SAMPLE_LONGTIME;
+            break;
+        case EnvelopeStage::ES_RELEASE:
+            tone.envLUT = releaseSlopeLUT;
+            tone.envStep = tone.releaseSlopeRatio;
+            tone.envScale = tone.strength;
+            tone.envRemain = slopeSamples(numReleaseSlopeLUT, tone.envStep);
+            break;
+        case EnvelopeStage::ES_DELAYOUT:
+            tone.strength = 0.0f;
+            tone.envRemain = (int64_t)(tone.maxDelayTime*samplesParMsec);
+            break;
+        default:
+            tone.envStage = EnvelopeStage::ES_END;
+            tone.envRemain = SAMPLE_LONGTIME;
+            break;
+    }
+}
+
+// makes envelope of one frame for the tone.
+// stages are switched at exact sample, and LUT index is only stepped in each stage.
+// [begin, end) is the sounding range in the frame. returns false when the tone ended.
+bool Sequencer::makeEnvelope(Tone &tone, float *env, int32_t &begin, int32_t &end) {
+    int32_t i = 0;
+    begin = 0;
+    while (i < bufferSamples) {
+        if (tone.envStage < EnvelopeStage::ES_RELEASE && tone.clock + i >= tone.releaseAt) {
+            setEnvelopeStage(tone, EnvelopeStage::ES_RELEASE);
+        }
+        while (tone.envRemain <= 0 && tone.envStage != EnvelopeStage::ES_END) {
+            setEnvelopeStage(tone, static_cast<EnvelopeStage>(static_cast<int32_t>(tone.envStage) + 1));
+        }
+        if (tone.envStage == EnvelopeStage::ES_END) break;
+
+        int32_t n = (int32_t)std::min(tone.envRemain, (int64_t)(bufferSamples - i));
+        if (tone.envStage < EnvelopeStage::ES_RELEASE) n = (int32_t)std::min((int64_t)n, tone.releaseAt - (tone.clock + i));
+
+        if (tone.envStage == EnvelopeStage::ES_WAIT) {
+            begin = i + n;
+        }
+        else if (tone.envLUT != nullptr) {
+            const float* lut = tone.envLUT;
+            float pos = tone.envPos;
+            float step = tone.envStep;
+            float scale = tone.envScale;
+            float bias = tone.envBias;
+            for (int32_t k = 0; k < n; k++) {
+                env[i+k] = bias + scale*lut[(int32_t)(pos + step*(float)k)];
+            }
+            tone.envPos += step*(float)n;
+            tone.strength = env[i+n-1];
+        }
+        else {
+            for (int32_t k = 0; k < n; k++) env[i+k] = tone.envBias;
         }
-        if (checkNewNote(oneNote) == false) break ;
+        tone.envRemain -= n;
+        i += n;
     }
-    currentTime += frameTime;
-    int32_t noiseBufIndex = frameCount*bufferSamples;
+    end = i;
+    tone.clock += bufferSamples;
+    return tone.envStage != EnvelopeStage::ES_END;
+}
+
+// constant power pan, normalized that centered tone keeps the level of mono output.
+// gains are kept while the pan is same, so a small frame does not pay the trigonometry.
+void Sequencer::updatePan(Tone &tone) {
+    float pan = channelPan[std::clamp(tone.note.channel, 0, numChannels - 1)];
+    pan += tone.instrument.pan + tone.instrument.stereoSpread*((float)tone.note.key - 64.0f)/64.0f;
+    pan = std::clamp(pan, -1.0f, 1.0f);
+    float volume = (tone.slot >= 0) ? slots[tone.slot].volume : 1.0f;
+    if (pan == tone.pan && volume == tone.volume) return;
+    tone.pan = pan;
+    tone.volume = volume;
+    float theta = (pan + 1.0f)*PI*0.25f;
+    tone.panLeft  = cosf(theta)*(float)Math_SQRT2*volume;
+    tone.panRight = sinf(theta)*(float)Math_SQRT2*volume;
+}
+
+// updates increments and AM level with LFO phases of the tone.
+void Sequencer::modulate(Tone &tone) {
     float period = (float)std::size(waveLUT[0])/(PI*2.0f);
-    float delta = 1.0f/samplingRate*1000.0f;
-    float div = 1.0f/asumedConcurrentTone; // to avoid saturation.
+    int32_t fmWave = static_cast<int32_t>(tone.instrument.fmWave);
+    float fmWaveInvert = 1.0f;
+    if (tone.instrument.fmWave == BaseWave::WAVE_SINSAWx2){
+        fmWave = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
+        fmWaveInvert = -1.0f;
+    }
+    int32_t amWave = static_cast<int32_t>(tone.instrument.amWave);
+    float amWaveInvert = 1.0f;
+    if (tone.instrument.amWave == BaseWave::WAVE_SINSAWx2){
+        amWave = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
+        amWaveInvert = -1.0f;
+    }
+    // mask keeps a phase rounded up to 2pi*period in the table.
+    float cent = 0.0f;
+    if (tone.instrument.fmCentRange != 0.0f) {
+        cent = tone.instrument.fmCentRange*(waveLUT[fmWave][(int32_t)(tone.fmPhase*period) & (waveLUTSize - 1)]*fmWaveInvert+1.0f)*0.5f;
+    }
+    float ratio = fastExp2(cent*(1.0f/1200.0f));
+    tone.modIncrement1 = std::min(tone.baseIncrement1*ratio, maxIncrement);
+    tone.modIncrement2 = std::min(tone.baseIncrement2*ratio, maxIncrement);
+    tone.modIncrement3 = std::min(tone.baseIncrement3*ratio, maxIncrement);
+
+    if (tone.instrument.amLevel == 0.0f) {
+        tone.modLevel = 1.0f;
+        return;
+    }
+    float level = (tone.instrument.amLevel)*(waveLUT[amWave][(int32_t)(tone.amPhase*period) & (waveLUTSize - 1)]*amWaveInvert+1.0f)*0.5f;
+    tone.modLevel = level + 1.0f - tone.instrument.amLevel;
+}
 
-    for (auto tone = activeTones.begin(); tone != activeTones.end();) {
-        float current = (float)tone->passed;
-        bool isEnd = false;
-        int32_t sinWave   = static_cast<int32_t>(BaseWave::WAVE_SIN);
-        int32_t baseWave1 = static_cast<int32_t>(tone->instrument.baseWave1);
-        int32_t baseWave2 = static_cast<int32_t>(tone->instrument.baseWave2);
-        int32_t baseWave3 = static_cast<int32_t>(tone->instrument.baseWave3);
-        int32_t fmWave = static_cast<int32_t>(tone->instrument.fmWave);
-        float fmWaveInvert = 1.0f;
-        if (tone->instrument.fmWave == BaseWave::WAVE_SINSAWx2){
-            fmWave = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
-            fmWaveInvert = -1.0f;
-        }
-        int32_t amWave = static_cast<int32_t>(tone->instrument.amWave);
-        float amWaveInvert = 1.0f;
-        if (tone->instrument.amWave == BaseWave::WAVE_SINSAWx2){
-            amWave = static_cast<int32_t>(BaseWave::WAVE_SAWTOOTH);
-            amWaveInvert = -1.0f;
-        }
-        double maxFrameValue = 0.0;
-        for (int32_t i = 0; i < bufferSamples; i++){
-            bool isTone = false;
-            if (current > tone->restartWaitDuration) {
-                tone->note.state = NState::NS_ON_FOREVER;
-                tone->mainteinDuration = tone->restartWaitDuration = FLOAT_LONGTIME;
-                tone->atackedStrengthfloor = tone->strength;
-                tone->waitDuration = current;
-                tone->tempo_f = tone->restartTempo_f;
-                tone->velocity_f = tone->restartVelocity_f;
-            }
-            if (current > tone->waitDuration+tone->mainteinDuration+tone->instrument.releaseSlopeTime+tone->maxDelayTime){
-                isEnd = true;
-                break;
-            }
-            else if (current > tone->waitDuration+tone->mainteinDuration){ // release
-                int32_t d = (int32_t)(((current-(tone->waitDuration+tone->mainteinDuration))*tone->releaseSlopeRatio)/delta);
-                if (d >= numReleaseSlopeLUT) d = numReleaseSlopeLUT - 1;
-                tone->atackedStrengthfloor = tone->strength = tone->decayedStrength*releaseSlopeLUT[d];
-                isTone = true;
-            }
-            else if (current > tone->waitDuration+tone->instrument.atackSlopeTime){ // decay and sustain
-                int32_t d = (int32_t)(((current-(tone->waitDuration+tone->instrument.atackSlopeTime))*tone->decaySlopeRatio)/delta);
-                if (d >= numDecaySlopeLUT) d = numDecaySlopeLUT - 1;
-                tone->strength = tone->atackedStrength*((decaySlopeLUT[d]*(1.0f-tone->instrument.sustainRate)+tone->instrument.sustainRate));
-                tone->atackedStrengthfloor = tone->decayedStrength = tone->strength;
-                isTone = true;
-            }
-            else if (current > tone->waitDuration){ // atack
-                int32_t d = (int32_t)((current-tone->waitDuration)*tone->atackSlopeRatio/delta);
-                if (d >= numAtackSlopeLUT) d = numAtackSlopeLUT - 1;
-                tone->strength = atackSlopeLUT[d]*(1.0f-tone->atackedStrengthfloor)+tone->atackedStrengthfloor;
-                tone->decayedStrength = tone->atackedStrength = tone->strength;
-                isTone = true;
-            }
+// peak is kept as max until it is read, rms is of the last frame.
+static void storePeak(std::atomic<float> &peak, float value){
+    float old = peak.load(std::memory_order_relaxed);
+    while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed)) {}
+}
+
+
+// render side, once par frame over the final mix.
+void Sequencer::measureLevels(const float *frame){
+    // 8 lanes of interleaved L and R, so the loop is vectorized without reordering of sums.
+    constexpr int32_t lanes = 8;
+    float peak[lanes] = {};
+    float square[lanes] = {};
+    int32_t samples = bufferSamples*2;
+    int32_t i = 0;
+    for (; i + lanes <= samples; i += lanes) {
+        for (int32_t k = 0; k < lanes; k++) {
+            float v = frame[i + k];
+            peak[k] = std::max(peak[k], std::fabs(v));
+            square[k] += v*v;
+        }
+    }
+    for (; i < samples; i++) {
+        peak[i & 1] = std::max(peak[i & 1], std::fabs(frame[i]));
+        square[i & 1] += frame[i]*frame[i];
+    }
+    float peakL = 0.0f, peakR = 0.0f, squareL = 0.0f, squareR = 0.0f;
+    for (int32_t k = 0; k < lanes; k += 2) {
+        peakL = std::max(peakL, peak[k]);
+        peakR = std::max(peakR, peak[k + 1]);
+        squareL += square[k];
+        squareR += square[k + 1];
+    }
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-            if (tone->atackedStrength > 1.0f) godot::UtilityFunctions::print("atackedStrength saturated! ", tone->atackedStrength);
-            if (tone->decayedStrength > 1.0f) godot::UtilityFunctions::print("decayedStrength saturated! ", tone->decayedStrength);
-            if (tone->strength > 1.0f)        godot::UtilityFunctions::print("strength saturated! ", tone->strength);
-            if (tone->atackedStrength < 0.0f) godot::UtilityFunctions::print("atackedStrength underflowed! ", tone->atackedStrength);
-            if (tone->decayedStrength < 0.0f) godot::UtilityFunctions::print("decayedStrength underflowed! ", tone->decayedStrength);
-            if (tone->strength < 0.0f)        godot::UtilityFunctions::print("strength underflowed! ", tone->strength);
+    if (logLevel > 0 && std::max(peakL, peakR) > 1.0f) godot::UtilityFunctions::print("saturated! ", std::max(peakL, peakR));
 #endif // DEBUG_ENABLED
-            if (isTone){
-                float inc1, inc2, inc3;
-                float cent;
-                if (tone->instrument.freqNoiseType == NoiseDistributType::NOISEDTYPE_TRIANGULAR) {
-                    cent = tone->freqNoiseCentharfRange*triangularDistributionLUT[noiseBufIndex+i];
-                }
-                else if (tone->instrument.freqNoiseType == NoiseDistributType::NOISEDTYPE_COS4ThPOW) {
-                    cent = tone->freqNoiseCentharfRange*cos4thPowDistributionLUT[noiseBufIndex+i];
-                }
-                else {
-                    cent = tone->freqNoiseCentharfRange*whiteNoiseLUT[noiseBufIndex+i];
-                }
-                if (current > tone->waitDuration){
-                    tone->fmPhase += tone->fmIncrement;
-                    if (tone->fmPhase > PI*2.0f) tone->fmPhase -= PI*2.0f;
-                    cent += tone->instrument.fmCentRange*(waveLUT[fmWave][(int32_t)(tone->fmPhase*period)]*fmWaveInvert+1.0f)*0.5f;
-                }
-                
-                inc1 = centFrequency(tone->baseIncrement1, cent);
-                inc2 = centFrequency(tone->baseIncrement2, cent);
-                inc3 = centFrequency(tone->baseIncrement3, cent);
+    float r = 1.0f/(float)bufferSamples;
+    storePeak(masterLevels[0], peakL);
+    storePeak(masterLevels[1], peakR);
+    masterLevels[2].store(std::sqrt(squareL*r), std::memory_order_relaxed);
+    masterLevels[3].store(std::sqrt(squareR*r), std::memory_order_relaxed);
+
+    if (!isChannelMeterEnabled) return;
+    // par channel from voices before pan, rms is sum of voice powers.
+    std::array<float, numChannels> channelPeak;
+    std::array<float, numChannels> channelSquare;
+    channelPeak.fill(0.0f);
+    channelSquare.fill(0.0f);
+    for (auto &tone : activeTones) {
+        int32_t ch = tone.note.channel;
+        if (ch < 0 || ch >= numChannels) continue;
+        channelPeak[ch] = std::max(channelPeak[ch], tone.framePeak);
+        channelSquare[ch] += tone.frameSquare;
+    }
+    for (int32_t ch = 0; ch < numChannels; ch++) {
+        storePeak(channelLevels[ch*2], channelPeak[ch]);
+        channelLevels[ch*2 + 1].store(std::sqrt(channelSquare[ch]*r), std::memory_order_relaxed);
+    }
+}
+
+
+// any thread. writes peak L, peak R, rms L, rms R and then peak, rms of each channel when withChannels.
+// peaks are reset by reading.
+int32_t Sequencer::getLevels(float *levels, bool withChannels){
+    for (int32_t k = 0; k < 2; k++) levels[k] = masterLevels[k].exchange(0.0f, std::memory_order_relaxed);
+    for (int32_t k = 2; k < 4; k++) levels[k] = masterLevels[k].load(std::memory_order_relaxed);
+    if (!withChannels) return 4;
+    for (int32_t ch = 0; ch < numChannels; ch++) {
+        levels[4 + ch*2]     = channelLevels[ch*2].exchange(0.0f, std::memory_order_relaxed);
+        levels[4 + ch*2 + 1] = channelLevels[ch*2 + 1].load(std::memory_order_relaxed);
+    }
+    return 4 + numChannels*2;
+}
+
+
+// renders one tone into frame with scratch buffers of the calling thread.
+// returns false when the tone has finished ringing.
+bool Sequencer::renderTone(Tone &tone, float *frame, VoiceScratch &scratch){
+    float* whiteNoise = scratch.whiteNoise.get();
+    float* pinkNoise = scratch.pinkNoise.get();
+    float* freqNoise = scratch.freqNoise.get();
+    float period = (float)std::size(waveLUT[0])/(PI*2.0f);
+    float div = 1.0f/asumedConcurrentTone; // to avoid saturation.
+    float* env = scratch.envelope.get();
+
+    int32_t begin, end;
+    bool isEnd = !makeEnvelope(tone, env, begin, end);
+    updatePan(tone);
+    float panLeft = tone.panLeft;
+    float panRight = tone.panRight;
+    int32_t sinWave   = static_cast<int32_t>(BaseWave::WAVE_SIN);
+    int32_t baseWave1 = static_cast<int32_t>(tone.instrument.baseWave1);
+    int32_t baseWave2 = static_cast<int32_t>(tone.instrument.baseWave2);
+    int32_t baseWave3 = static_cast<int32_t>(tone.instrument.baseWave3);
+    float c = 1.0f/120.0f; // key 120 may be 8372.0Hz
+    float r1 = std::clamp((float)(tone.realKey1)*c, 0.0f, 1.0f);
+    float r2 = std::clamp((float)(tone.realKey2)*c, 0.0f, 1.0f);
+    float r3 = std::clamp((float)(tone.realKey3)*c, 0.0f, 1.0f);
+    const BakedWave* baked = tone.baked;
+    bool hasFreqNoise = (tone.freqNoiseCentharfRange != 0.0f);
+    bool hasMixNoise = (tone.instrument.noiseRatio != 0.0f);
+    const float* mixNoise = whiteNoise;
+    if ((hasFreqNoise || hasMixNoise) && begin < end) {
+        tone.noise.makeNoise(whiteNoise + begin, hasFreqNoise ? freqNoise + begin : nullptr, end - begin, tone.instrument.freqNoiseType);
+        if (hasMixNoise && tone.instrument.noiseColorType == NoiseColorType::NOISECTYPE_PINK) {
+            tone.noise.makePink(pinkNoise + begin, whiteNoise + begin, end - begin, dcBlockPole);
+            mixNoise = pinkNoise;
+        }
+    }
+    float framePeak = 0.0f;
+    float frameSquare = 0.0f;
+    for (int32_t i = begin; i < end;){
+        // LFOs and cent conversion are done once par control period, and increments are interpolated linearly.
+        int32_t n = std::min(tone.controlPeriod, end - i);
+        float modIncrement1 = tone.modIncrement1;
+        float modIncrement2 = tone.modIncrement2;
+        float modIncrement3 = tone.modIncrement3;
+        float level = tone.modLevel;
+        // a fast LFO may step over 2pi in one control period, and a LFO of no depth is not moved.
+        if (tone.instrument.fmCentRange != 0.0f) {
+            tone.fmPhase += tone.fmIncrement*(float)n;
+            if (tone.fmPhase >= PI*2.0f) tone.fmPhase = fmodf(tone.fmPhase, PI*2.0f);
+        }
+        if (tone.instrument.amLevel != 0.0f) {
+            tone.amPhase += tone.amIncrement*(float)n;
+            if (tone.amPhase >= PI*2.0f) tone.amPhase = fmodf(tone.amPhase, PI*2.0f);
+        }
+        modulate(tone);
+        float r = 1.0f/(float)n;
+        float modStep1 = (tone.modIncrement1 - modIncrement1)*r;
+        float modStep2 = (tone.modIncrement2 - modIncrement2)*r;
+        float modStep3 = (tone.modIncrement3 - modIncrement3)*r;
+        float levelStep = (tone.modLevel - level)*r;
+        for (int32_t k = 0; k < n; k++, i++){
+            modIncrement1 += modStep1;
+            modIncrement2 += modStep2;
+            modIncrement3 += modStep3;
+            level += levelStep;
+
+            float inc1 = modIncrement1, inc2 = modIncrement2, inc3 = modIncrement3;
+            if (hasFreqNoise) {
+                float cent = tone.freqNoiseCentharfRange*freqNoise[i];
+                float noise = fastExp2(cent*(1.0f/1200.0f));
+                inc1 = std::min(inc1*noise, maxIncrement);
+                inc2 = std::min(inc2*noise, maxIncrement);
+                inc3 = std::min(inc3*noise, maxIncrement);
+            }
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-                if (inc1 < 0.0f) godot::UtilityFunctions::print("inc1 is going backwards! ", inc1);
-                if (inc2 < 0.0f) godot::UtilityFunctions::print("inc2 is going backwards! ", inc2);
-                if (inc3 < 0.0f) godot::UtilityFunctions::print("inc3 is going backwards! ", inc3);
+            if (inc1 < 0.0f) godot::UtilityFunctions::print("inc1 is going backwards! ", inc1);
+            if (inc2 < 0.0f) godot::UtilityFunctions::print("inc2 is going backwards! ", inc2);
+            if (inc3 < 0.0f) godot::UtilityFunctions::print("inc3 is going backwards! ", inc3);
 #endif // DEBUG_ENABLED
-                
-                tone->phase1 += inc1;
-                if (tone->phase1 > PI*2.0f) tone->phase1 -= PI*2.0f;
-                tone->phase2 += inc2;
-                if (tone->phase2 > PI*2.0f) tone->phase2 -= PI*2.0f;
-                tone->phase3 += inc3;
-                if (tone->phase3 > PI*2.0f) tone->phase3 -= PI*2.0f;
-                
-                float level = 1.0f;
-                if (current > tone->waitDuration){
-                    tone->amPhase += tone->amIncrement;
-                    if (tone->amPhase > PI*2.0f) tone->amPhase -= PI*2.0f;
-                    level = (tone->instrument.amLevel)*(waveLUT[amWave][(int32_t)(tone->amPhase*period)]*amWaveInvert+1.0f)*0.5f;
-                    level += 1.0f - tone->instrument.amLevel;
-                }
-
+        
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-                if (level > 1.0f) godot::UtilityFunctions::print("level saturated! ", level);
+            if (level > 1.0f) godot::UtilityFunctions::print("level saturated! ", level);
 #endif // DEBUG_ENABLED
-                
-                float tone1, tone2, tone3;
-                {
-                    double c = 1.0/120.0; // key 120 may be 8372.0Hz
-                    double f1 = (double)waveLUT[sinWave][(int32_t)(tone->phase1*period)];
-                    double f2 = (double)waveLUT[sinWave][(int32_t)(tone->phase2*period)];
-                    double f3 = (double)waveLUT[sinWave][(int32_t)(tone->phase3*period)];
-
-                    double g1 = (double)waveLUT[baseWave1][(int32_t)(tone->phase1*period)];
-                    double g2 = (double)waveLUT[baseWave2][(int32_t)(tone->phase2*period)];
-                    double g3 = (double)waveLUT[baseWave3][(int32_t)(tone->phase3*period)];
-
-                    double r1 = godot::Math::clamp((double)(tone->realKey1)*c, 0.0, 1.0);
-                    double r2 = godot::Math::clamp((double)(tone->realKey2)*c, 0.0, 1.0);
-                    double r3 = godot::Math::clamp((double)(tone->realKey3)*c, 0.0, 1.0);
-
-                    tone1 = (float)godot::Math::lerp(g1, f1, r1)*tone->base1ratio;
-                    tone2 = (float)godot::Math::lerp(g2, f2, r2)*tone->base2ratio;
-                    tone3 = (float)godot::Math::lerp(g3, f3, r3)*tone->base3ratio;
-                }
-                float data = tone1+tone2+tone3;
-                
-                if (tone->instrument.noiseColorType == NoiseColorType::NOISECTYPE_WHITE) {
-                    data = data*(1.0f - tone->instrument.noiseRatio)+whiteNoiseLUT[noiseBufIndex+i]*tone->instrument.noiseRatio;
-                }
-                else if (tone->instrument.noiseColorType == NoiseColorType::NOISECTYPE_PINK) {
-                    data = data*(1.0f - tone->instrument.noiseRatio)+pinkNoiseLUT[noiseBufIndex+i]*tone->instrument.noiseRatio;
-                }
+        
+            float data;
+            // phases stay in [0, 2pi), and the mask keeps one rounded up to 2pi*period in the table.
+            if (baked != nullptr) {
+                tone.phase1 += inc1;
+                if (tone.phase1 >= PI*2.0f) tone.phase1 -= PI*2.0f;
+                int32_t x = (int32_t)(tone.phase1*period) & (waveLUTSize - 1);
+                data = baked->base[x] + tone.bakedKey*baked->slope[x];
+            }
+            else {
+                tone.phase1 += inc1;
+                if (tone.phase1 >= PI*2.0f) tone.phase1 -= PI*2.0f;
+                tone.phase2 += inc2;
+                if (tone.phase2 >= PI*2.0f) tone.phase2 -= PI*2.0f;
+                tone.phase3 += inc3;
+                if (tone.phase3 >= PI*2.0f) tone.phase3 -= PI*2.0f;
+                int32_t x1 = (int32_t)(tone.phase1*period) & (waveLUTSize - 1);
+                int32_t x2 = (int32_t)(tone.phase2*period) & (waveLUTSize - 1);
+                int32_t x3 = (int32_t)(tone.phase3*period) & (waveLUTSize - 1);
+
+                float f1 = waveLUT[sinWave][x1];
+                float f2 = waveLUT[sinWave][x2];
+                float f3 = waveLUT[sinWave][x3];
+
+                float g1 = waveLUT[baseWave1][x1];
+                float g2 = waveLUT[baseWave2][x2];
+                float g3 = waveLUT[baseWave3][x3];
+
+                float tone1 = (g1 + (f1 - g1)*r1)*tone.base1ratio;
+                float tone2 = (g2 + (f2 - g2)*r2)*tone.base2ratio;
+                float tone3 = (g3 + (f3 - g3)*r3)*tone.base3ratio;
+                data = tone1+tone2+tone3;
+            }
+        
+            if (hasMixNoise) {
+                data = data*(1.0f - tone.instrument.noiseRatio)+mixNoise[i]*tone.instrument.noiseRatio;
+            }
 
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-                if (godot::Math::absf(data) > 1.0){
-                    godot::UtilityFunctions::print("data 1 saturated! ", data);
-                }
+            if (godot::Math::absf(data) > 1.0){
+                godot::UtilityFunctions::print("data 1 saturated! ", data);
+            }
 #endif // DEBUG_ENABLED
-                data = godot::Math::clamp(data, -1.0f, 1.0f);
 
-                data *= (tone->velocity_f*tone->strength*div*level)*tone->instrument.totalGain;
+            data *= (tone.velocity_f*env[i]*div*level)*tone.instrument.totalGain;
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-                if (godot::Math::absf(data) > 1.0){
-                    godot::UtilityFunctions::print("data 2 saturated! ", data);
-                }
+            if (godot::Math::absf(data) > 1.0){
+                godot::UtilityFunctions::print("data 2 saturated! ", data);
+            }
 #endif // DEBUG_ENABLED
-                data = godot::Math::clamp(data, -1.0f, 1.0f);
 
-                data = data * tone->mainRatio + tone->delayBuffer[tone->delayBufferIndex];
+            data = data * tone.mainRatio + tone.delayBuffer[tone.delayBufferIndex];
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-                if (godot::Math::absf(data) > 1.0){
-                    godot::UtilityFunctions::print("data 3 saturated! ", data);
-                }
+            if (godot::Math::absf(data) > 1.0){
+                godot::UtilityFunctions::print("data 3 saturated! ", data);
+            }
 #endif // DEBUG_ENABLED
-                data = godot::Math::clamp(data, -1.0f, 1.0f);
-                
-                // delay
-                float delayData;
-                delayData = tone->delayBuffer[tone->delay0Index] + data * tone->delay0Ratio;
-                if (delayData >  1.0) delayData =  1.0;
-                if (delayData < -1.0) delayData = -1.0;
-                tone->delayBuffer[tone->delay0Index] = delayData;
-                delayData = tone->delayBuffer[tone->delay1Index] + data * tone->delay1Ratio;
-                if (delayData >  1.0) delayData =  1.0;
-                if (delayData < -1.0) delayData = -1.0;
-                tone->delayBuffer[tone->delay1Index] = delayData;
-                delayData = tone->delayBuffer[tone->delay2Index] + data * tone->delay2Ratio;
-                if (delayData >  1.0) delayData =  1.0;
-                if (delayData < -1.0) delayData = -1.0;
-                tone->delayBuffer[tone->delay2Index] = delayData;
-
-                tone->delay0Index += 1;
-                if (tone->delay0Index == delayBufferSize) tone->delay0Index = 0;
-                tone->delay1Index +=1;
-                if (tone->delay1Index == delayBufferSize) tone->delay1Index = 0;
-                tone->delay2Index += 1;
-                if (tone->delay2Index == delayBufferSize) tone->delay2Index = 0;
-                tone->delayBuffer[tone->delayBufferIndex] = 0.0f;
-                tone->delayBufferIndex +=1;
-                if (tone->delayBufferIndex == delayBufferSize) tone->delayBufferIndex = 0;
-
-                frame[i] += (double)data;
-                if (godot::Math::absf(frame[i]) > maxFrameValue) maxFrameValue = godot::Math::absf(frame[i]);
-                frame[i] = godot::Math::clamp(frame[i], -1.0, 1.0);
+        
+            // delay. the voice is not clipped, the mix is clipped once on the bus,
+            // but the feedback buffer is kept in range so a ringing delay cannot grow.
+            float delayData;
+            delayData = tone.delayBuffer[tone.delay0Index] + data * tone.delay0Ratio;
+            if (delayData >  1.0) delayData =  1.0;
+            if (delayData < -1.0) delayData = -1.0;
+            tone.delayBuffer[tone.delay0Index] = delayData;
+            delayData = tone.delayBuffer[tone.delay1Index] + data * tone.delay1Ratio;
+            if (delayData >  1.0) delayData =  1.0;
+            if (delayData < -1.0) delayData = -1.0;
+            tone.delayBuffer[tone.delay1Index] = delayData;
+            delayData = tone.delayBuffer[tone.delay2Index] + data * tone.delay2Ratio;
+            if (delayData >  1.0) delayData =  1.0;
+            if (delayData < -1.0) delayData = -1.0;
+            tone.delayBuffer[tone.delay2Index] = delayData;
+
+            tone.delay0Index += 1;
+            if (tone.delay0Index == delayBufferSize) tone.delay0Index = 0;
+            tone.delay1Index +=1;
+            if (tone.delay1Index == delayBufferSize) tone.delay1Index = 0;
+            tone.delay2Index += 1;
+            if (tone.delay2Index == delayBufferSize) tone.delay2Index = 0;
+            tone.delayBuffer[tone.delayBufferIndex] = 0.0f;
+            tone.delayBufferIndex +=1;
+            if (tone.delayBufferIndex == delayBufferSize) tone.delayBufferIndex = 0;
+
+            float* out = frame + i*2;
+            out[0] += data*panLeft;
+            out[1] += data*panRight;
+            framePeak = std::max(framePeak, godot::Math::absf(data));
+            frameSquare += data*data;
+        }
+    }
+    tone.framePeak = framePeak;
+    tone.frameSquare = frameSquare;
+    return !isEnd;
+}
+
+
+// rough cost of a tone par sample, used to balance voice groups.
+int32_t Sequencer::estimateCost(const Tone &tone){
+    int32_t cost = (tone.baked != nullptr) ? 1 : 3;
+    if (tone.freqNoiseCentharfRange != 0.0f) cost += 2;
+    if (tone.instrument.noiseRatio != 0.0f) cost += (tone.instrument.noiseColorType == NoiseColorType::NOISECTYPE_PINK) ? 2 : 1;
+    if (tone.controlPeriod == 1) cost += 2;
+    if (tone.maxDelayTime > 0.0f) cost += 1;
+    return std::min(cost, maxToneCost);
+}
+
+
+// splits voices into numVoiceGroups by cost, heaviest first into the lightest group.
+// it depends only on the voices, so the mix is same with any number of threads.
+void Sequencer::groupVoices(void){
+    std::array<int32_t, numVoiceGroups> load;
+    load.fill(0);
+    for (auto &group : voiceGroups) group.clear();
+    for (int32_t cost = maxToneCost; cost > 0; cost--) {
+        for (auto &tone : activeTones) {
+            if (estimateCost(tone) != cost) continue;
+            int32_t lightest = (int32_t)(std::min_element(load.begin(), load.end()) - load.begin());
+            voiceGroups[lightest].push_back(&tone);
+            load[lightest] += cost;
+        }
+    }
+}
+
+bool Sequencer::feed(float *frame){
+    for (int i=0; i < bufferSamples*2; i++) frame[i] = 0.0f; // interleaved stereo.
+    drainCommands();
+
+    // events before the end of this frame, the voice starts at exact sample by its envelope.
+    // the parser is not called until its next event is due, so a small frame costs little.
+    // each slot is parsed on its own timeline from its origin.
+    int64_t frameEnd = currentTime + bufferSamples;
+    for (int32_t k = 0; k < numSlots; k++) {
+        SequenceSlot &slot = slots[k];
+        if (!isSet || slot.midi == nullptr) continue;
+        while(slot.midi->getNextTime() < frameEnd - slot.origin) {
+            Note oneNote = slot.midi->parse(frameEnd - slot.origin);
+            if (oneNote.state == NState::NS_END || oneNote.state == NState::NS_EMPTY) {
+                break;
             }
-            current += delta;
+            oneNote.startTime += slot.origin;
+            oneNote.channel = (oneNote.channel + slot.channelOffset) % numChannels;
+            oneNote.tempo = (int32_t)std::lround(oneNote.tempo*slot.tempoScale);
+            if (checkNewNote(oneNote, -1, k) == false) break ;
         }
-        if (maxFrameValue > 1.0){
-#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
-            godot::UtilityFunctions::print("saturated! ", maxFrameValue);
-#endif // DEBUG_ENABLED
+    }
+    currentTime += bufferSamples;
+    if ((int32_t)activeTones.size() < parallelVoices || workers == nullptr) {
+        for (auto &tone : activeTones) {
+            tone.isSounding = renderTone(tone, frame, scratches[0]);
         }
-        if (maxFrameValue > maxValue) maxValue = maxFrameValue;
-        {
-            godot::Dictionary dic;
-            dic["msg"]                = (int32_t)1;
-            dic["max_level"]          = (int32_t)(maxValue*1000.0);
-            dic["frame_level"]        = (int32_t)(maxFrameValue*1000.0);
-            emitSignal(dic);
+    }
+    else {
+        // each group has own bus, and buses are summed in fixed order.
+        groupVoices();
+        workers->run(numVoiceGroups, voiceJob);
+        for (int32_t g = 0; g < numVoiceGroups; g++) {
+            if (voiceGroups[g].empty()) continue;
+            const float* bus = groupBus[g];
+            for (int32_t i = 0; i < bufferSamples*2; i++) frame[i] += bus[i];
         }
+    }
 
-        maxFrameValue = 0.0;
-        if (isEnd && tone->restartWaitDuration == FLOAT_LONGTIME){
+    measureLevels(frame);
+
+    releaseSilentTones();
+
+    uint32_t playing = 0;
+    for (int32_t k = 0; k < numSlots; k++) {
+        SequenceSlot &slot = slots[k];
+        if (slot.midi == nullptr) continue;
+        if (!slot.midi->isEnded()) playing |= 1u << k;
+        if (!slot.isLoop || !slot.midi->isEnded()) continue;
+        if (std::any_of(activeTones.begin(), activeTones.end(), [&](const Tone &tone){ return tone.slot == k; })) continue;
+        slot.midi->setUnitOfTime(unitOfTime/slot.tempoScale);
+        slot.midi->restart();
+//        slot.origin = currentTime + (int64_t)samplingRate; // wait 1sec for repetition.
+        slot.origin = currentTime; // or executed immediately without waiting.
+        playing |= 1u << k;
+    }
+    playingSlots.store(playing, std::memory_order_relaxed);
+    activeVoices.store((int32_t)activeTones.size(), std::memory_order_relaxed);
+    sampleClock.fetch_add(bufferSamples, std::memory_order_relaxed);
+    if (hasNewNoteEvents) {
+        hasNewNoteEvents = false;
+        if (notifyNoteEvents) notifyNoteEvents();
+    }
+    return true;
+}
+
+
+// render side, all tones are stopped at once. tones are relinked, not allocated, unlike resetTones().
+void Sequencer::stopTones(void) {
+    for (auto &tone : activeTones) tone.isSounding = false;
+    releaseSilentTones();
+}
+
+
+// render side, tones that rang out go back to freeTones with their borrowed buffers.
+void Sequencer::releaseSilentTones(void) {
+    for (auto tone = activeTones.begin(); tone != activeTones.end();) {
+        if (!tone->isSounding){
             tone->phase1 = tone->phase2 = tone->phase3  = 0.0f;
             tone->strength = 0.0f;
             tone->atackedStrength = 0.0f;
-            tone->decayedStrength = 0.0f;
-            freeTones.insert(freeTones.end(), *tone);
-            tone = activeTones.erase(tone);
+            setBakedWave(*tone, nullptr);
+            if (voicePool != nullptr) {
+                voicePool->release(tone->delayBuffer);
+                tone->delayBuffer = nullptr;
+            }
+            auto next = std::next(tone);
+            freeTones.splice(freeTones.end(), activeTones, tone);
+            tone = next;
             continue;
         }
-        tone->passed += (int32_t)(delta * (float)bufferSamples);
         tone++;
     }
-    frameCount += 1;
-    frameCount %= noiseBufSize;
-
-    if (oneNote.state == NState::NS_END && activeTones.size() == 0){
-        midi.restart();
-//        currentTime = -1000; // wait 1sec for repetition.
-        currentTime = 0; // or executed immediately without waiting.
-    }
-    return true;
 }
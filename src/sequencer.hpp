@@ -32,16 +32,38 @@
 #include <filesystem>
 
 #include <cmath>
+#include <cstring>
 #include "smfparser.hpp"
 #include <list>
 #include <array>
+#include <map>
+#include <memory>
 #include <functional>
-#include <godot_cpp/classes/random_number_generator.hpp>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include "mpscqueue.hpp"
+#include "workerpool.hpp"
+#include "lutregistry.hpp"
+#include "voicepool.hpp"
 #include <godot_cpp/classes/image.hpp>
 #include <godot_cpp/classes/json.hpp>
 
 #define PI (float)Math_PI
-#define FLOAT_LONGTIME 36000000.0f
+#define SAMPLE_LONGTIME 0x7fffffffffffffffLL // tone times are 64 bits, so a held note never wraps.
+
+// 2^x without branch ladder nor table. relative error is under 1e-6 (0.002 cent).
+inline float fastExp2(float x) {
+    x = std::clamp(x, -126.0f, 126.0f);
+    float fi = floorf(x);
+    float f = x - fi;
+    float p = 1.0f + f*(0.69315159f + f*(0.24016438f + f*(0.05579371f + f*(0.00903121f + f*0.00185873f))));
+    int32_t bits = ((int32_t)fi + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p*scale;
+}
 
 enum class BaseWave {
     WAVE_SIN,         //  0
@@ -69,6 +91,18 @@ enum class NoiseColorType {
     NOISECTYPE_TAIL
 };
 
+enum class EnvelopeStage {
+    ES_WAIT,      //  0 waiting for the note start in the first frame.
+    ES_ATACK,     //  1
+    ES_DECAY,     //  2
+    ES_SUSTAIN,   //  3
+    ES_RELEASE,   //  4
+    ES_DELAYOUT,  //  5 silent, only delay buffer is ringing out.
+    ES_END,       //  6
+
+    ES_TAIL
+};
+
 struct Instrument{
     float totalGain;
     
@@ -111,6 +145,9 @@ struct Instrument{
     float amPhaseOffset;
     int32_t amSync;
     BaseWave amWave;
+
+    float pan;           // -1.0(left) to 1.0(right), added to pan of channel.
+    float stereoSpread;  // 0.0 to 1.0, spreads notes from left(low key) to right(high key).
 };
 
 struct Percussion{
@@ -118,6 +155,82 @@ struct Percussion{
     int32_t key;
 };
 
+// header of .gdsbank file. instruments and percussions follow it as they are in memory,
+// so a file is loaded with one read and one pass of validation. little endian only.
+struct BankFileHeader{
+    char magic[4];            // "GDSB"
+    uint32_t version;
+    uint32_t numInstruments;
+    uint32_t instrumentSize;  // bytes par instrument.
+    uint32_t numPercussions;
+    uint32_t percussionSize;  // bytes par percussion.
+    uint32_t checksum;        // FNV-1a of the body.
+    uint32_t reserved;
+};
+
+enum class CommandType {
+    CT_NOTE_ON,         //  0
+    CT_NOTE_OFF,        //  1
+    CT_CONTROL_PARAMS,  //  2
+    CT_SLOT_LOAD,       //  3
+    CT_SLOT_UNLOAD,     //  4 slot -1 is all slots.
+    CT_SLOT_RESTART,    //  5
+    CT_SLOT_PARAMS,     //  6
+
+    CT_TAIL
+};
+
+struct NoteArgs{
+    int32_t channel;
+    int32_t key;
+    int32_t velocity;
+    int32_t program;
+    int32_t tempo;
+};
+
+struct ControlArgs{
+    float divisionNum;
+    int32_t logLevel;
+    int32_t controlPeriod;    // 0 is unchanged.
+    int32_t renderThreads;    // -1 is unchanged, applied on the control side.
+    int32_t parallelVoices;   // 0 is unchanged.
+    int32_t channelMeters;    // -1 is unchanged.
+};
+
+struct SlotArgs{
+    int32_t slot;
+    int32_t loop;             // -1 is unchanged.
+    int32_t channelOffset;    // -1 is unchanged.
+    float volume;             // negative is unchanged.
+    double tempo;             // 0 is unchanged.
+    SMFParser *smf;           // parsed by the control side, which owns it.
+    uint64_t serial;          // of slot commands, tells the control side that the old smf is let go.
+};
+
+// control input from any thread, applied by the render side at head of a frame.
+struct Command{
+    CommandType type;
+    int64_t sampleTime;  // target sample on Sequencer clock, negative is as soon as possible.
+    uint32_t order;      // arrival, given by drainCommands() to keep FIFO among same sampleTime.
+    union {
+        NoteArgs note;
+        ControlArgs control;
+        SlotArgs slot;
+    };
+};
+
+// note on/off reported to the main thread, same items as note_changed signal.
+struct NoteEvent{
+    int32_t onOff;
+    int32_t trackNum;
+    int32_t channel;
+    int32_t velocity;
+    int32_t program;
+    int32_t key;
+    int32_t instrumentNum;
+    int32_t key2;
+};
+
 class PinkNoise {
 private:
     static constexpr int32_t tapNum  = 16;
@@ -130,18 +243,38 @@ public:
     float makeNoise (float);    
 };
 
+// counter based noise generator that each tone owns.
+class NoiseGenerator {
+private:
+    uint32_t seed = 0;
+    uint32_t counter = 0;
+    PinkNoise pinkNoise;
+    float dcIn = 0.0f;  // DC blocker for slow taps of PinkNoise.
+    float dcOut = 0.0f;
+    static float pinkGain(void);
+public:
+    void reset(uint32_t);
+    void makeNoise(float *, float *, int32_t, NoiseDistributType);
+    void makePink(float *, const float *, int32_t, float);
+};
+
 
 class Sequencer {
+    friend struct SequencerTest; // native tests in tests/ set up the render side.
 public:
     // constant control params.
     static constexpr int32_t numinstruments = 256;
     static constexpr int32_t numPercussions = 128;
+    static constexpr int32_t numChannels = 32;
+    static constexpr int32_t numSlots = 4; // smf played at once.
 
 private:
     // constant control params.
     static constexpr int32_t numTone = 64;
 //    static constexpr int32_t waveLUTSize = 8192;
-    static constexpr int32_t waveLUTSize = 32768;
+    static constexpr int32_t waveLUTSize = WaveTables::size;
+    static_assert((waveLUTSize & (waveLUTSize - 1)) == 0, "LFO phase is masked by waveLUTSize");
+    static_assert(WaveTables::numWaves == static_cast<int32_t>(BaseWave::WAVE_TAIL));
     static constexpr float delayBufferDuration = 500.0;// msec
 
     struct Tone {
@@ -150,17 +283,19 @@ private:
         int32_t velocity;
         float velocity_f;
         int32_t tempo;
-        float tempo_f;
-        int32_t restartVelocity;
-        float restartVelocity_f;
-        int32_t restartTempo;
-        float restartTempo_f;
+        float tempo_f; // beats par second.
+        int32_t slot = -1; // sequence slot of the note, -1 is a live note.
 
         // envelope factor
+        EnvelopeStage envStage = EnvelopeStage::ES_END;
+        int64_t envRemain = 0;     // samples left in current stage.
+        const float* envLUT = nullptr;
+        float envPos = 0.0f;       // look-up table position at head of frame.
+        float envStep = 0.0f;      // look-up table step par sample.
+        float envScale = 0.0f;
+        float envBias = 0.0f;
         float strength = 0.0;
         float atackedStrength = 0.0f;
-        float decayedStrength = 0.0f;
-        float atackedStrengthfloor = 0.0f;
         float atackSlopeRatio;
         float decaySlopeRatio;
         float releaseSlopeRatio;
@@ -177,12 +312,16 @@ private:
         float base2ratio;
         float base3ratio;
         float frequency;
-        int32_t passed;
-        float waitDuration;
-        float restartWaitDuration;
-        float mainteinDuration;
+        int64_t clock;      // samples passed since the frame of note on.
+        int32_t startAt;    // sample of note on, in the first frame.
+        int64_t releaseAt;  // sample of note off.
 
         float freqNoiseCentharfRange;
+        NoiseGenerator noise;
+
+        // baked wave, or nullptr to mix 3 oscillators. counted in its users while it is set.
+        const BakedWave* baked = nullptr;
+        float bakedKey;
         
         Instrument instrument;
         
@@ -204,6 +343,13 @@ private:
         //am moduration
         float amPhase;
         float amIncrement;
+
+        // modulation at control rate, they are values at the end of last control period.
+        int32_t controlPeriod;
+        float modIncrement1;
+        float modIncrement2;
+        float modIncrement3;
+        float modLevel;
         
         int32_t program;
         int32_t key;
@@ -211,76 +357,243 @@ private:
         int32_t realKey2;
         int32_t realKey3;
         float maxDelayTime;
+
+        // stereo gains, updated when pan or volume of the slot is changed.
+        float pan;
+        float volume;
+        float panLeft;
+        float panRight;
+
+        // result of renderTone() in this frame.
+        float framePeak = 0.0f;
+        float frameSquare = 0.0f;
+        bool isSounding = true;
+    };
+
+    // scratch buffers of one rendering thread.
+    struct VoiceScratch {
+        std::unique_ptr<float []> envelope;
+        std::unique_ptr<float []> whiteNoise;
+        std::unique_ptr<float []> pinkNoise;
+        std::unique_ptr<float []> freqNoise;
+    };
+    void setEnvelopeStage(Tone &, EnvelopeStage);
+    void modulate(Tone &);
+    bool useBakedWave(Tone &);
+    void updatePan(Tone &);
+
+    // immutable snapshot of instruments. writers copy the last one, update and publish it (RCU),
+    // so the render side never sees a half written instrument. a replaced bank is kept in retiredBanks
+    // until the render side has let it go, and its baked waves still played by tones in retiredWaves,
+    // so banks and baked waves are always freed on the control side.
+    struct InstrumentBank {
+        uint64_t version = 0;
+        bool isBaked = true;
+        std::array<Instrument, numinstruments> instruments;
+        std::array<Percussion, numPercussions> percussions;
+        std::array<std::shared_ptr<const BakedWave>, numinstruments> bakedWaves;
     };
-    SMFParser midi;
+    std::mutex bankMutex;  // control side, guards publishedBank and retiredBanks.
+    std::shared_ptr<const InstrumentBank> publishedBank;
+    std::vector<std::shared_ptr<const InstrumentBank>> retiredBanks;
+    std::vector<std::shared_ptr<const BakedWave>> retiredWaves;
+    std::atomic<const InstrumentBank*> nextBank {nullptr};  // publishedBank for the render side.
+    std::atomic<uint64_t> bankVersion {0};
+    std::atomic<const InstrumentBank*> bankInUse {nullptr};  // set by the render side before it trusts the pointer.
+    const InstrumentBank* bank = nullptr;  // render side, picked up at head of each frame.
+    void bakeInstrument(InstrumentBank &, int32_t);
+    void publishBank(std::shared_ptr<InstrumentBank>);
+    void trimRetiredBanks(void);
+    void pickUpBank(void);
+    void setBakedWave(Tone &, const BakedWave*);
+    static void clampInstrument(Instrument &);
+    static bool isValidInstrument(const Instrument &);
+    bool makeEnvelope(Tone &, float *, int32_t &, int32_t &);
+    bool renderTone(Tone &, float *, VoiceScratch &);
+    void postNoteEvent(int32_t, const Tone &);
+    void measureLevels(const float *);
+    int32_t estimateCost(const Tone &);
+    void groupVoices(void);
+    // each slot plays one smf on its own timeline into the shared voices and bus.
+    // render side, midi is nullptr when nothing is loaded.
+    struct SequenceSlot {
+        SMFParser *midi = nullptr;
+        int64_t origin = 0; // currentTime at head of the smf.
+        bool isLoop = true;
+        float volume = 1.0f;
+        int32_t channelOffset = 0; // added to channels, 16 moves a layer to channels 16-31.
+        double tempoScale = 1.0;
+    };
+    std::array<SequenceSlot, numSlots> slots;
+    std::atomic<uint32_t> playingSlots {0};  // bit par slot, written at end of each frame.
+
+    // control side copies, so setters and getters of the main thread never wait for the render side.
+    // smfs are parsed and owned here, a replaced one is kept in retiredSmfs until the render side let it go.
+    struct SlotState {
+        std::unique_ptr<SMFParser> smf;
+        bool isLoop = true;
+        float volume = 1.0f;
+        int32_t channelOffset = 0;
+        double tempoScale = 1.0;
+    };
+    std::mutex controlMutex;  // never taken by the render side.
+    std::array<SlotState, numSlots> slotStates;
+    std::vector<std::pair<uint64_t, std::unique_ptr<SMFParser>>> retiredSmfs;
+    uint64_t slotSerial = 0;
+    std::atomic<uint64_t> appliedSlotSerial {0};
+    ControlArgs controlState {4.0f, 1, 32, 0, 16, 0};  // as applied, no unchanged values.
+    bool pushSlotCommand(Command &);
+    bool handOverSmf(int32_t, std::unique_ptr<SMFParser>);
+    void stopTones(void);
+    void releaseSilentTones(void);
     int32_t delayBufferSize = 0;
-    float unitOfTime = 60000.0;
+    double unitOfTime = 44100.0*60.0; // samples par minute, smf is parsed on the sample timeline.
     std::array<Tone, numTone> toneInstances;
     std::list<Tone> activeTones;
     std::list<Tone> freeTones;
-    std::array<Instrument, numinstruments> instruments;
-    std::array<Percussion, numPercussions> percussions;
+    std::array<float, numChannels> channelPan;
 
     float samplingRate = 44100.0f;
     float bufferingTime = 0.05f;
     int32_t bufferSamples;
+    float samplesParMsec = 44.1f;
 
-    int32_t currentTime = 0;
-    int32_t frameCount = 0;
-    int32_t noiseBufSize;
-    int32_t noiseBuffer;
+    int64_t currentTime = 0; // sample at the head of the frame in the smf timeline.
+    uint32_t noiseSeed = 0; // unique par instance, set by the constructor.
     bool isSet = false;
-    std::array<std::array<float, waveLUTSize>, static_cast<int32_t>(BaseWave::WAVE_TAIL)> waveLUT;
+    // look-up tables are shared with other Sequencers through LUTRegistry.
+    std::shared_ptr<const WaveTables> waveTables = LUTRegistry::getWaves();
+    std::shared_ptr<const SlopeTables> slopeTables;
+    const float (*waveLUT)[waveLUTSize] = waveTables->wave;
+    const float* velocity2powerLUT = waveTables->velocity2power;
 
-    float atackSlopeHz = 25.0;
-    std::unique_ptr<float []> atackSlopeLUT;
+    const float* atackSlopeLUT = nullptr;
     float atackSlopeTime;
     int32_t numAtackSlopeLUT;
     
-    float releaseSlopeHz = 25.0;
-    std::unique_ptr<float []> releaseSlopeLUT;
+    const float* releaseSlopeLUT = nullptr;
     float releaseSlopeTime;
     int32_t numReleaseSlopeLUT;
     
-    float decaySlopeHz = 1.0;
-    float decayHalfLifeTime = 50.0;
-    std::unique_ptr<float []> decaySlopeLUT;
+    static constexpr float dcBlockHz = 7.0224f; // pole of 0.999 at 44.1kHz.
+    float dcBlockPole = 0.999f;
+    const float* decaySlopeLUT = nullptr;
     float decaySlopeTime;
+    float decayHalfLifeTime;
     int32_t numDecaySlopeLUT;
     
     float sustainRate = 0.0;
-    godot::RandomNumberGenerator *rand;
-
-    std::unique_ptr<float []> velocity2powerLUT;
-    std::unique_ptr<float []> whiteNoiseLUT;
-    std::unique_ptr<float []> pinkNoiseLUT;
-    std::unique_ptr<float []> triangularDistributionLUT;
-    std::unique_ptr<float []> cos4thPowDistributionLUT;
-    static constexpr int32_t pow2_x_1200LUT_size = 7200;
-    std::unique_ptr<float []> pow2_x_1200LUT;
+
+    // voices are rendered in groups by workers when there are many.
+    static constexpr int32_t maxRenderThreads = 7;
+    static constexpr int32_t numVoiceGroups = 8;
+    static constexpr int32_t maxToneCost = 10;
+    int32_t parallelVoices = 16;  // voices from which they are rendered in groups.
+
+    // with a voice pool, delay buffers are borrowed par note instead of owned par tone.
+    VoicePool* voicePool = nullptr;
+    int32_t voicePriority = 0;
+    int32_t getOwnWorkers(void) const;
+    std::atomic<int32_t> voiceLimit {numTone};  // max active tones, lowered by SynthServer over its cpu budget.
+    std::atomic<int32_t> activeVoices {0};
+    std::atomic<int64_t> droppedVoices {0};
+    // the pool of workers is made on the control side and picked up by the render side at head of a frame,
+    // a replaced one is kept until then, so threads are never started nor joined while rendering.
+    std::unique_ptr<WorkerPool> ownWorkers;  // control side, with ownWorkerCount threads besides the caller of feed().
+    int32_t ownWorkerCount = -1;
+    std::vector<std::pair<uint64_t, std::unique_ptr<WorkerPool>>> retiredWorkers;
+    std::atomic<WorkerPool*> publishedWorkers {nullptr};
+    std::atomic<uint64_t> workersVersion {0};
+    std::atomic<uint64_t> usedWorkersVersion {0};
+    WorkerPool* workers = nullptr;  // render side.
+    void publishWorkers(void);
+    void pickUpWorkers(void);
+    std::array<VoiceScratch, maxRenderThreads + 1> scratches;
+    std::array<std::vector<Tone*>, numVoiceGroups> voiceGroups;
+    std::unique_ptr<float []> groupBusStore;
+    std::array<float*, numVoiceGroups> groupBus;  // cache line aligned in groupBusStore.
+    std::function<void(int32_t, int32_t)> voiceJob;
+    static constexpr float maxIncrement = 2.0f*PI*0.47f; // 0.47 of sampling rate is upper limit.
+    static constexpr int32_t maxControlPeriod = 256;
+    int32_t controlPeriod = 32; // samples par LFO update.
     
     float asumedConcurrentTone = 4.0f;
-    bool checkNewNote(Note);
+    bool checkNewNote(Note, int32_t offset = -1, int32_t slot = -1);
+
+    // command queue, filled by any thread and drained at head of each frame.
+    static constexpr int32_t commandQueueSize = 4096;
+    MpscQueue<Command> commands {commandQueueSize};
+    std::vector<Command> pendingCommands;  // min-heap by sample time of commands waiting for it.
+    uint32_t commandOrder = 0;
+    std::atomic<int64_t> sampleClock {0};  // samples rendered so far.
+    bool pushCommand(const Command &);
+    bool pushNote(CommandType, int64_t, int32_t, int32_t, int32_t, int32_t, int32_t);
+    void applyCommand(const Command &, int32_t);
+
+    // note events, written by the render side and read by the main thread.
+    static constexpr int32_t noteEventQueueSize = 1024;
+    MpscQueue<NoteEvent> noteEvents {noteEventQueueSize};
+    bool hasNewNoteEvents = false;
+    std::atomic<int64_t> droppedNoteEvents {0};
+
+    // meters, written by the render side once par frame.
+    std::array<std::atomic<float>, 4> masterLevels;  // peak L, peak R, rms L, rms R.
+    std::array<std::atomic<float>, numChannels*2> channelLevels;  // peak, rms par MIDI channel.
+    bool isChannelMeterEnabled = false;
     int32_t logLevel = 1;
 public:
-    double maxValue = 0.0;
+    static constexpr int32_t maxLevels = 4 + numChannels*2;
+    static constexpr int32_t instrumentStride = sizeof(Instrument)/sizeof(float); // floats par instrument in packed bank.
+    static constexpr int32_t noteRecordStride = 6; // time, channel, key, velocity, program, onOff in submitNotes().
+    static constexpr int32_t liveTempo = 120; // for tempo synced LFOs of notes without tempo.
     float noteFrequency(int8_t);
     float centFrequency(float, float);
     bool initParam(double, double, int32_t);
     godot::Array getInstruments(void);
     void setInstruments(const godot::Array);
+    godot::PackedFloat32Array getInstrumentsPacked(void);
+    int32_t setInstrumentsPacked(const float *, int64_t, int32_t);
+    uint64_t getInstrumentVersion(void) const;
+    static constexpr uint32_t bankFileVersion = 1;
+    static constexpr int64_t bankFileSize = sizeof(BankFileHeader) + sizeof(Instrument)*numinstruments + sizeof(Percussion)*numPercussions;
+    godot::PackedByteArray getBankBytes(void);
+    void getBankBytes(uint8_t *);
+    bool setBankBytes(const uint8_t *, int64_t);
+    void copyBank(Sequencer &);
     void setControlParams(const godot::Dictionary);
     godot::Dictionary getControlParams(void);
     void setPercussions(const godot::Array);
     godot::Array getPercussions(void);
     void incertNoteOn(const godot::Dictionary);
     void incertNoteOff(const godot::Dictionary);
+    void noteOn(int64_t, int32_t, int32_t, int32_t, int32_t);
+    void noteOff(int64_t, int32_t, int32_t);
+    int64_t submitNotes(const int32_t *, int64_t);
+    void drainCommands(void);
+    int64_t getSampleClock(void) const;
+    bool popNoteEvent(NoteEvent &);
+    int64_t getDroppedNoteEvents(void) const;
+    int32_t getLevels(float *, bool);
     godot::Ref<godot::Image> getMiniWavePicture(const godot::Dictionary);
-    bool feed(double*);
-    bool smfLoad(const char*, double);
-    bool smfLoad(const godot::String &, double);
+    bool feed(float*);
+    static constexpr int32_t maxVoices = numTone;
+    void resetTones(void);
+    void setVoicePool(VoicePool*, int32_t);
+    void setVoiceLimit(int32_t);
+    int32_t getVoiceLimit(void) const;
+    int32_t getActiveVoices(void) const;
+    int64_t getDroppedVoices(void) const;
+    int32_t getDelayBufferSize(void) const;
+    void setRenderThreads(int32_t);
+    bool smfLoad(const char*, int32_t slot = 0);
+    bool smfLoad(const godot::String &, int32_t slot = 0);
     bool smfUnload(void);
-    std::function<void(const godot::Dictionary dic)> emitSignal;
+    bool smfUnload(int32_t);
+    bool smfRestart(int32_t);
+    bool isFinished(void) const;
+    void setSlotParams(int32_t, const godot::Dictionary);
+    godot::Dictionary getSlotParams(int32_t);
+    std::function<void(void)> notifyNoteEvents;  // called at end of a frame that posted note events.
     Sequencer();
     ~Sequencer();
 };
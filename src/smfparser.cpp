@@ -33,7 +33,7 @@
 #include <godot_cpp/variant/utility_functions.hpp> // for "UtilityFunctions::print()".
 #endif // DEBUG_ENABLED
 
-SMFParser::SMFParser() : unitOfTime(60000.0f), position(0), tempo(60) {
+SMFParser::SMFParser() : unitOfTime(60000.0), position(0), tempo(60) {
 }
 
 SMFParser::~SMFParser(){
@@ -44,6 +44,7 @@ SMFParser::~SMFParser(){
 void SMFParser::unload(void) {
     
     position = 0;
+    nextTime = 0;
     filesize = 0;
     formatType = 0;
     numOfTracks = 0;
@@ -57,6 +58,7 @@ void SMFParser::unload(void) {
 bool SMFParser::load(const char *name) {
     std::ifstream in;
     position = 0;
+    nextTime = 0;
 
     in.open(name, std::ios::in | std::ios::binary);
     if (!in.is_open()) return false;
@@ -102,7 +104,7 @@ bool SMFParser::load(const char *name) {
     position = (uint32_t)data_top;
 
     tempo = 60; // as default
-    tempos.push_back({0, tempo, 0.0});
+    tempos.push_back({0, (double)tempo, 0.0});
     for (int32_t i = 0; i < numOfTracks; ++i) {
         std::string str = getStr(4);
         if (str.compare("MTrk") != 0) {
@@ -132,6 +134,7 @@ bool SMFParser::load(const char *name) {
 
 bool SMFParser::load(const godot::String &name) {
     position = 0;
+    nextTime = 0;
     auto in = godot::FileAccess::open(name, godot::FileAccess::READ);
 
     if (!in->is_open()) return false;
@@ -175,7 +178,7 @@ bool SMFParser::load(const godot::String &name) {
     position = (uint32_t)data_top;
 
     tempo = 60; // as default
-    tempos.push_back({0, tempo, 0.0});
+    tempos.push_back({0, (double)tempo, 0.0});
     for (int32_t i = 0; i < numOfTracks; ++i) {
         std::string str = getStr(4);
         if (str.compare("MTrk") != 0) {
@@ -204,26 +207,29 @@ bool SMFParser::load(const godot::String &name) {
 
 
 void SMFParser::restart(void) {
+    nextTime = 0;
     tempos.clear();
-    tempos.push_back({0, tempo, 0.0});
+    tempos.push_back({0, (double)tempo, 0.0});
     for (int32_t i = 0; i < numOfTracks; ++i) {
         tracks[i].tempo = tempo;
         tracks[i].position = tracks[i].top;
         tracks[i].previousEvent = 0;
         tracks[i].program = 0;
         tracks[i].tick = 0;
+        tracks[i].endTick = 0;
         tracks[i].state = TState::TS_EMPTY;
         tracks[i].nextNote.startTick = 0;
     }
 }
 
 
-Note SMFParser::parse(int32_t till) {
+Note SMFParser::parse(int64_t till) {
     Note retNote;
     retNote.state = NState::NS_EMPTY;
     int32_t numServed = 0;
     for (uint32_t i = 0; i < numOfTracks; ++i) {
         if (tracks[i].position >= tracks[i].tail){
+            if (tracks[i].state != TState::TS_SERVED) tracks[i].endTick = tracks[i].tick;
             tracks[i].state = TState::TS_SERVED;
             tracks[i].nextNote.startTick = (uint32_t)(-1);
         }
@@ -295,13 +301,26 @@ Note SMFParser::parse(int32_t till) {
                     }
                     break;
 
-                case 0xb0: // Controller (ignored)
+                case 0xb0: // Controller
                     {
                         int8_t controller = getByte(&(tracks[i].position));
                         int8_t value = getByte(&(tracks[i].position));  
 //#if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
 //                        godot::UtilityFunctions::print("Controller: ",controller, " ", value, " ch=", channel);
 //#endif // DEBUG_ENABLED
+
+                        tracks[i].nextNote = {
+                            .state        = NState::NS_CONTROL,
+                            .trackNum     = (int32_t)i,
+                            .channel      = (int32_t)channel,
+                            .key          = (int32_t)controller,
+                            .velocity     = (int32_t)value,
+                            .program      = (int32_t)tracks[i].program,
+                            .startTick    = tracks[i].tick,
+                            .startTime    = 0,
+                            .tempo        = 0
+                        };
+                        tracks[i].state = TState::TS_FOUND;
                     }
                     break;
 
@@ -413,6 +432,7 @@ Note SMFParser::parse(int32_t till) {
 
                                 case 0x2f: // END OF TRACK
                                     {
+                                        tracks[i].endTick = tracks[i].tick;
                                         tracks[i].state = TState::TS_SERVED;
                                     }
                                     break;
@@ -420,7 +440,7 @@ Note SMFParser::parse(int32_t till) {
                                 case 0x51: // MetaSetTempo
                                     {
                                         uint32_t metaSetTempo = getBytes(3, &(tracks[i].position));
-                                        const uint32_t BPM = 60000000 / metaSetTempo;
+                                        const double BPM = 60000000.0 / metaSetTempo;
 #if defined(DEBUG_ENABLED) && defined(WINDOWS_ENABLED)
                                         godot::UtilityFunctions::print("MetaSetTempo: ", metaSetTempo);
                                         godot::UtilityFunctions::print("       Track: ", i);
@@ -432,10 +452,10 @@ Note SMFParser::parse(int32_t till) {
                                             tempos.push_back({tracks[i].tick, BPM});
                                             std::sort(tempos.begin(), tempos.end());
                                     
-                                            float elapsedTicks = 0.0f;
-                                            float time = 0.0f;
+                                            uint32_t elapsedTicks = 0;
+                                            double time = 0.0;
                                             for (int32_t j = 1; j < tempos.size(); ++j) {
-                                                time += (unitOfTime/tempos[j-1].tempo)*((tempos[j].tick-elapsedTicks)/timeDivision);
+                                                time += (unitOfTime/tempos[j-1].tempo)*((double)(tempos[j].tick-elapsedTicks)/timeDivision);
                                                 elapsedTicks = tempos[j].tick;
                                                 tempos[j].time = time;
                                             }
@@ -482,6 +502,7 @@ Note SMFParser::parse(int32_t till) {
 
     if (numServed == numOfTracks){
         retNote.state = NState::NS_END;
+        nextTime = INT64_MAX;
     }
     else {
         int32_t minTick = 0x7fffffff; // set very large number
@@ -497,10 +518,12 @@ Note SMFParser::parse(int32_t till) {
             return (tracks[j].nextNote.startTick < bpm.tick);
         }) - 1;
         if (it != tempos.end()) {
-            const float TEMPO = ((unitOfTime / it->tempo) /  timeDivision);
-            tracks[j].nextNote.tempo = (int32_t)it->tempo;
-            tracks[j].nextNote.startTime = (int32_t)(it->time + ((tracks[j].nextNote.startTick - it->tick) * TEMPO));
+            const double TEMPO = ((unitOfTime / it->tempo) /  timeDivision);
+            tracks[j].nextNote.tempo = (int32_t)std::lround(it->tempo);
+            // rounded once from the tempo segment head, so error is not accumulated.
+            tracks[j].nextNote.startTime = (int64_t)std::llround(it->time + ((tracks[j].nextNote.startTick - it->tick) * TEMPO));
         }
+        nextTime = tracks[j].nextNote.startTime;
         if(tracks[j].nextNote.startTime < till){
             tracks[j].state = TState::TS_EMPTY;
             retNote = tracks[j].nextNote;
@@ -510,14 +533,35 @@ Note SMFParser::parse(int32_t till) {
 }
 
 
-void SMFParser::setUnitOfTime(float unit) {
+void SMFParser::setUnitOfTime(double unit) {
     unitOfTime = unit;
 }
 
-float SMFParser::getUnitOfTime() const {
+double SMFParser::getUnitOfTime() const {
     return unitOfTime;
 }
 
+// time of the next event known by the last parse(), or 0 when it has to be parsed again.
+int64_t SMFParser::getNextTime() const {
+    return nextTime;
+}
+
+bool SMFParser::isEnded() const {
+    return nextTime == INT64_MAX;
+}
+
+// time of the latest end of track, known when isEnded(). trailing silence of a song is kept by it.
+int64_t SMFParser::getEndTime() const {
+    uint32_t endTick = 0;
+    for (uint32_t i = 0; i < numOfTracks; ++i) {
+        endTick = std::max(endTick, tracks[i].endTick);
+    }
+    auto it = std::find_if(tempos.begin(), tempos.end(), [&](const Tempo &bpm) {
+        return (endTick < bpm.tick);
+    }) - 1;
+    return (int64_t)std::llround(it->time + ((endTick - it->tick) * ((unitOfTime / it->tempo) / timeDivision)));
+}
+
 
 uint32_t SMFParser::getBytes(uint16_t length) {
     uint32_t value = 0;
@@ -31,6 +31,7 @@
 
 #include <iostream>
 #include <cstdint>
+#include <cmath>
 #include <cstring>
 #include <vector>
 #include <fstream>
@@ -44,6 +45,7 @@ enum class NState {
 
     NS_EMPTY,        //  2
     NS_END,          //  3
+    NS_CONTROL,      //  4 control change, key is controller and velocity is value.
 
     NS_TAIL
 };
@@ -64,7 +66,7 @@ struct Note {
     int32_t velocity;
     int32_t program;
     uint32_t startTick;
-    int32_t startTime;
+    int64_t startTime;  // in unit of time, samples in the sequencer.
     int32_t tempo;
     bool operator<(const Note& another) const {
         return startTick < another.startTick;
@@ -94,8 +96,9 @@ private:
     uint32_t formatType = 0;
     
     uint32_t position;
-    float unitOfTime;
+    double unitOfTime; // units par minute.
     uint32_t tempo;
+    int64_t nextTime = 0;
 
     struct Track {
         TState state;
@@ -104,6 +107,7 @@ private:
         uint32_t top;
         uint32_t length;
         uint32_t tail;
+        uint32_t endTick = 0; // tick of end of track, or of the last event without it.
         uint32_t tempo;
         uint32_t position;
         uint8_t previousEvent = 0;
@@ -113,8 +117,9 @@ private:
     std::vector<Track> tracks;
 
     struct Tempo {
-        uint32_t tick, tempo;
-        float time;
+        uint32_t tick;
+        double tempo; // BPM, not truncated.
+        double time;
         bool operator<(const Tempo& another) const {
             return tick < another.tick;
         }
@@ -129,7 +134,10 @@ public:
     bool load(const godot::String &);
     void unload(void);
     void restart(void);
-    Note parse(int32_t);
-    void setUnitOfTime(float);
-    float getUnitOfTime() const;
+    Note parse(int64_t);
+    void setUnitOfTime(double);
+    double getUnitOfTime() const;
+    int64_t getNextTime() const;
+    bool isEnded() const;
+    int64_t getEndTime() const;
 };
@@ -0,0 +1,292 @@
+/**************************************************************************/
+/*  synthserver.cpp                                                       */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "synthserver.hpp"
+#include <algorithm>
+#include <chrono>
+
+SynthServer::SynthServer() {
+    threads = std::clamp((int32_t)std::thread::hardware_concurrency()/2 - 1, 0, 7);
+    passPlayers.reserve(64); // a pass of usual count of players does not allocate.
+    workerBusy.fill(0.0);
+    playerJob = [this](int32_t job, int32_t worker) {
+        workerBusy[worker] += passPlayers[job]->renderAhead(passAhead);
+    };
+}
+
+SynthServer::~SynthServer() {
+    stop();
+}
+
+SynthServer &SynthServer::getSingleton(void) {
+    static SynthServer server;
+    return server;
+}
+
+// the pool is made for the delay buffers of the first player, players of other rates are refused.
+// on the pool, the sequencer drops own render workers, its voices are rendered on the worker of the pass.
+bool SynthServer::addPlayer(ServerPlayer* player, double rate) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int32_t size = player->sequencer->getDelayBufferSize();
+    if (players.empty()) {
+        if (pool.getCapacity() != maxVoices || pool.getBufferSize() != size) {
+            pool.init(maxVoices, size);
+        }
+        mixRate = rate;
+        setAhead();
+    }
+    else if (pool.getBufferSize() != size || rate != mixRate) {
+        return false;
+    }
+    player->priority = std::clamp(player->priority, 0, VoicePool::numPriorities - 1);
+    player->runLocked([&]() { player->sequencer->setVoicePool(&pool, player->priority); });
+    player->sequencer->setVoiceLimit(Sequencer::maxVoices);
+    players.push_back(player);
+    sortPlayers();
+    if (!isRunning.load()) start();
+    return true;
+}
+
+// the player gets own delay buffers back, its ringing tones are stopped.
+// a running pass may still hold the player in its snapshot, so it is waited for.
+void SynthServer::removePlayer(ServerPlayer* player) {
+    bool isLast = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = std::find(players.begin(), players.end(), player);
+        if (it == players.end()) return;
+        players.erase(it);
+        waitPass(lock);
+        player->runLocked([&]() { player->sequencer->setVoicePool(nullptr, 0); });
+        player->sequencer->setVoiceLimit(Sequencer::maxVoices);
+        isLast = players.empty();
+    }
+    if (isLast) stop();
+}
+
+void SynthServer::setPriority(ServerPlayer* player, int32_t priority) {
+    std::lock_guard<std::mutex> lock(mutex);
+    player->priority = std::clamp(priority, 0, VoicePool::numPriorities - 1);
+    if (std::find(players.begin(), players.end(), player) == players.end()) return;
+    player->runLocked([&]() { player->sequencer->setVoicePool(&pool, player->priority); });
+    sortPlayers();
+}
+
+double SynthServer::getLatency(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return latency;
+}
+
+// a consumer of a player calls it with fill of its ring after reading, a fill under the low water mark wakes the pass.
+void SynthServer::notifyRead(int64_t fill) {
+    if (fill >= lowWaterFrames.load(std::memory_order_relaxed)) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        isWakeRequested = true;
+    }
+    wake.notify_one();
+}
+
+// caller holds mutex.
+void SynthServer::setAhead(void) {
+    aheadFrames = (int64_t)(latency*mixRate);
+    lowWaterFrames.store(aheadFrames/2, std::memory_order_relaxed);
+}
+
+// caller holds mutex, no pass starts until it is released.
+void SynthServer::waitPass(std::unique_lock<std::mutex> &lock) {
+    passDone.wait(lock, [this]() { return !isPassRunning; });
+}
+
+void SynthServer::sortPlayers(void) {
+    std::stable_sort(players.begin(), players.end(), [](const ServerPlayer* a, const ServerPlayer* b) {
+        return a->priority > b->priority;
+    });
+}
+
+void SynthServer::start(void) {
+#if defined(WEB_ENABLED) && !defined(__EMSCRIPTEN_PTHREADS__)
+    return; // no threads on this build.
+#else
+    workers.resize(threads);
+    isRunning.store(true);
+    thread = std::thread(&SynthServer::threadLoop, this);
+#endif
+}
+
+void SynthServer::stop(void) {
+    if (!isRunning.load()) {
+        return;
+    }
+    isRunning.store(false);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    workers.resize(0);
+}
+
+// one pass renders every player ahead, players of higher priority are picked by workers first.
+// the pass renders a snapshot of players without mutex, busy is time in feed() of the most loaded worker,
+// so waits on locks of nodes are not counted. between passes the thread sleeps until a ring
+// is read under the low water mark, or a quarter of the latency at most.
+void SynthServer::threadLoop(void) {
+    using clock = std::chrono::steady_clock;
+    auto windowBegin = clock::now();
+    double busy = 0.0;
+    std::chrono::duration<double> nap {0.0};
+    while (isRunning.load(std::memory_order_acquire)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            passPlayers.assign(players.begin(), players.end());
+            passAhead = aheadFrames;
+            nap = std::chrono::duration<double>(latency*0.25);
+            isPassRunning = true;
+        }
+        workerBusy.fill(0.0);
+        workers.run((int32_t)passPlayers.size(), playerJob);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isPassRunning = false;
+            passes++;
+            busy += *std::max_element(workerBusy.begin(), workerBusy.end());
+            double window = std::chrono::duration<double>(clock::now() - windowBegin).count();
+            if (window >= budgetInterval) {
+                load = busy/window;
+                applyBudget();
+                windowBegin = clock::now();
+                busy = 0.0;
+            }
+        }
+        passDone.notify_all();
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, nap, [this]() { return isWakeRequested || !isRunning.load(); });
+        isWakeRequested = false;
+    }
+}
+
+// over the budget, the player of lowest priority with most voices loses a quarter of them.
+// under a half of the budget, the player of highest priority which was limited gets 4 voices back.
+// caller holds mutex.
+void SynthServer::applyBudget(void) {
+    if (load > cpuBudget) {
+        ServerPlayer* victim = nullptr;
+        for (auto player : players) {
+            int32_t active = player->sequencer->getActiveVoices();
+            if (active <= 1) continue;
+            if (victim == nullptr || player->priority < victim->priority
+                || (player->priority == victim->priority && active > victim->sequencer->getActiveVoices())) {
+                victim = player;
+            }
+        }
+        if (victim != nullptr) {
+            int32_t active = victim->sequencer->getActiveVoices();
+            victim->sequencer->setVoiceLimit(std::min(victim->sequencer->getVoiceLimit(), active - std::max(active/4, 1)));
+            voiceCuts++;
+        }
+    }
+    else if (load < cpuBudget*0.5) {
+        for (auto player : players) { // higher priority first.
+            int32_t limit = player->sequencer->getVoiceLimit();
+            if (limit < Sequencer::maxVoices) {
+                player->sequencer->setVoiceLimit(limit + 4);
+                break;
+            }
+        }
+    }
+}
+
+// a new number of voices stops ringing tones of all players to make the pool again.
+void SynthServer::setParams(const godot::Dictionary dic) {
+    std::unique_lock<std::mutex> lock(mutex);
+    latency = std::clamp((double)dic.get("latency", latency), 0.005, 1.0);
+    setAhead();
+    cpuBudget = std::clamp((double)dic.get("cpuBudget", cpuBudget), 0.05, 1.0);
+    int32_t nextThreads = std::clamp((int32_t)dic.get("threads", threads), 0, maxThreads);
+    if (nextThreads != threads) {
+        threads = nextThreads;
+        if (isRunning.load()) {
+            waitPass(lock); // workers of the pass are not resized under it.
+            workers.resize(threads);
+        }
+    }
+    int32_t voices = std::clamp((int32_t)dic.get("voices", maxVoices), 1, 4096);
+    if (voices != maxVoices) {
+        maxVoices = voices;
+        if (!players.empty()) {
+            // a pass may render any node, so all nodes are locked until the pool is made again,
+            // and no tone keeps a buffer of the old one.
+            std::function<void(size_t)> resetFrom = [&](size_t k) {
+                if (k == players.size()) {
+                    pool.init(maxVoices, pool.getBufferSize());
+                    return;
+                }
+                players[k]->runLocked([&]() {
+                    players[k]->sequencer->resetTones();
+                    resetFrom(k + 1);
+                });
+            };
+            resetFrom(0);
+        }
+    }
+}
+
+godot::Dictionary SynthServer::getParams(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    godot::Dictionary dic;
+    dic["voices"] = maxVoices;
+    dic["latency"] = latency;
+    dic["cpuBudget"] = cpuBudget;
+    dic["threads"] = threads;
+    return dic;
+}
+
+// load is busy ratio of the server thread in last budget interval.
+godot::Dictionary SynthServer::getStats(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    godot::Dictionary dic;
+    int32_t limited = 0;
+    int64_t dropped = 0;
+    for (auto player : players) {
+        if (player->sequencer->getVoiceLimit() < Sequencer::maxVoices) limited++;
+        dropped += player->sequencer->getDroppedVoices();
+    }
+    dic["players"] = (int64_t)players.size();
+    dic["voices"] = pool.getCapacity();
+    dic["voicesUsed"] = pool.getUsed();
+    dic["load"] = load;
+    dic["passes"] = passes;
+    dic["voiceCuts"] = voiceCuts;
+    dic["limitedPlayers"] = limited;
+    dic["droppedVoices"] = dropped; // notes refused by budget, of players now on the server.
+    return dic;
+}
@@ -0,0 +1,111 @@
+/**************************************************************************/
+/*  synthserver.hpp                                                       */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#ifndef SYNTHSERVER_H
+#define SYNTHSERVER_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sequencer.hpp"
+#include "voicepool.hpp"
+#include "workerpool.hpp"
+
+// a player rendered by SynthServer, owned by its node and registered while it uses the server.
+struct ServerPlayer {
+    Sequencer* sequencer = nullptr;
+    std::function<double(int64_t)> renderAhead; // renders blocks until the frames are buffered, returns seconds in feed().
+    std::function<void(const std::function<void(void)> &)> runLocked; // runs a change of the sequencer under the render lock of the node.
+    int32_t priority = 1; // 0:lowest to 3:highest.
+};
+
+// process wide renderer of many players. one thread renders all players in one pass,
+// each player on a worker, with one voice pool and one cpu budget for all of them.
+// over the budget, voices of players of lower priority are limited first.
+// a pass renders a snapshot of players without mutex, and sleeps until a ring is read under its low water mark.
+class SynthServer {
+private:
+    static constexpr int32_t maxThreads = 15;
+    std::mutex mutex; // guards players and params, a pass holds it only to take its snapshot and to account.
+    std::condition_variable passDone;
+    bool isPassRunning = false;
+    std::vector<ServerPlayer*> players; // higher priority first.
+    std::vector<ServerPlayer*> passPlayers; // snapshot of players, server thread only.
+    VoicePool pool;
+    WorkerPool workers;
+    std::thread thread;
+    std::atomic<bool> isRunning {false};
+    std::function<void(int32_t, int32_t)> playerJob;
+    std::array<double, maxThreads + 1> workerBusy; // seconds in feed() par worker in a pass.
+    int64_t aheadFrames = 0;
+    int64_t passAhead = 0; // aheadFrames of the pass.
+    std::atomic<int64_t> lowWaterFrames {0}; // a ring under it wakes the pass.
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool isWakeRequested = false;
+
+    int32_t maxVoices = 128;
+    double latency = 0.1; // seconds rendered ahead.
+    double cpuBudget = 0.7; // max busy ratio of the server thread.
+    int32_t threads = 0; // workers besides the server thread.
+    double mixRate = 44100.0;
+
+    double load = 0.0;
+    int64_t passes = 0;
+    int64_t voiceCuts = 0;
+    static constexpr double budgetInterval = 0.25; // seconds par budget check.
+
+    void start(void);
+    void stop(void);
+    void threadLoop(void);
+    void applyBudget(void);
+    void sortPlayers(void);
+    void setAhead(void);
+    void waitPass(std::unique_lock<std::mutex> &);
+    SynthServer();
+public:
+    ~SynthServer();
+    static SynthServer &getSingleton(void);
+    bool addPlayer(ServerPlayer*, double);
+    void removePlayer(ServerPlayer*);
+    void setPriority(ServerPlayer*, int32_t);
+    void notifyRead(int64_t);
+    double getLatency(void);
+    void setParams(const godot::Dictionary);
+    godot::Dictionary getParams(void);
+    godot::Dictionary getStats(void);
+};
+
+#endif // SYNTHSERVER_H
@@ -0,0 +1,90 @@
+/**************************************************************************/
+/*  voicepool.hpp                                                         */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#ifndef VOICEPOOL_H
+#define VOICEPOOL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// delay buffers of voices shared by Sequencers rendered by SynthServer.
+// a buffer is lent at note on and given back when the tone ends, so idle players hold none.
+// the number of buffers is the voice budget of all players. a player of lower priority
+// can not take the last buffers, they are reserved for players of higher priority.
+class VoicePool {
+private:
+    std::mutex mutex;
+    std::unique_ptr<float[]> store;
+    std::vector<float*> freeBuffers;
+    int32_t capacity = 0;
+    int32_t bufferSize = 0; // floats par buffer.
+public:
+    static constexpr int32_t numPriorities = 4; // 0:lowest to 3:highest.
+
+    // not thread safe, call while no buffer is lent.
+    void init(int32_t voices, int32_t size) {
+        capacity = std::max(voices, 0);
+        bufferSize = std::max(size, 0);
+        store = std::make_unique<float[]>((size_t)capacity*bufferSize);
+        freeBuffers.clear();
+        freeBuffers.reserve(capacity);
+        for (int32_t i = capacity - 1; i >= 0; i--) {
+            freeBuffers.push_back(&store[(size_t)i*bufferSize]);
+        }
+    }
+    int32_t getCapacity(void) const {return capacity;}
+    int32_t getBufferSize(void) const {return bufferSize;}
+    int32_t getUsed(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return capacity - (int32_t)freeBuffers.size();
+    }
+    // nullptr when the budget for the priority is used up.
+    float* acquire(int32_t priority) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int32_t reserve = (capacity/16)*(numPriorities - 1 - std::clamp(priority, 0, numPriorities - 1));
+        if ((int32_t)freeBuffers.size() <= reserve) {
+            return nullptr;
+        }
+        float* buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        return buffer;
+    }
+    void release(float* buffer) {
+        if (buffer == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(buffer);
+    }
+};
+
+#endif // VOICEPOOL_H
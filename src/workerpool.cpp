@@ -0,0 +1,114 @@
+/**************************************************************************/
+/*  workerpool.cpp                                                        */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#include "workerpool.hpp"
+
+WorkerPool::~WorkerPool() {
+    resize(0);
+}
+
+// number of threads besides the caller, 0 runs every job on the caller.
+// threads are started and joined here, so it is not called from a render thread.
+void WorkerPool::resize(int32_t workers) {
+    if (workers == (int32_t)threads.size()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isQuit.store(true);
+    }
+    wake.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    isQuit.store(false);
+#if defined(WEB_ENABLED) && !defined(__EMSCRIPTEN_PTHREADS__)
+    workers = 0; // no threads on this build.
+#endif
+    for (int32_t i = 0; i < workers; i++) {
+        threads.emplace_back(&WorkerPool::workerLoop, this, i + 1, generation.load());
+    }
+}
+
+int32_t WorkerPool::size(void) const {
+    return (int32_t)threads.size() + 1;
+}
+
+// the caller does its share and then spins for the last jobs of others, which are already running.
+void WorkerPool::run(int32_t count, const std::function<void(int32_t, int32_t)> &func) {
+    if (threads.empty()) {
+        for (int32_t i = 0; i < count; i++) func(i, 0);
+        return;
+    }
+    job = &func;
+    jobCount = count;
+    nextJob.store(0, std::memory_order_relaxed);
+    busyWorkers.store((int32_t)threads.size(), std::memory_order_relaxed);
+    generation.fetch_add(1); // publishes the batch.
+    if (sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(mutex); } // a sleeper is in wait() or sees the new generation.
+        wake.notify_all();
+    }
+    runJobs(0);
+    while (busyWorkers.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+    job = nullptr;
+}
+
+void WorkerPool::runJobs(int32_t worker) {
+    while (true) {
+        int32_t i = nextJob.fetch_add(1);
+        if (i >= jobCount) break;
+        (*job)(i, worker);
+    }
+}
+
+bool WorkerPool::isPosted(uint64_t seen) const {
+    return isQuit.load() || generation.load() != seen;
+}
+
+// seen is the last batch before the start, the thread may be scheduled after next batch is posted.
+void WorkerPool::workerLoop(int32_t worker, uint64_t seen) {
+    while (true) {
+        for (int32_t i = 0; i < spinCount && !isPosted(seen); i++) {
+            std::this_thread::yield();
+        }
+        if (!isPosted(seen)) {
+            sleepers.fetch_add(1);
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]{ return isPosted(seen); });
+            sleepers.fetch_sub(1);
+        }
+        if (isQuit.load()) return;
+        seen = generation.load();
+        runJobs(worker);
+        busyWorkers.fetch_sub(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,67 @@
+/**************************************************************************/
+/*  workerpool.hpp                                                        */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small pool of threads that runs a batch of jobs and waits for all of them.
+// the caller of run() joins the batch as worker 0, so job gets worker index 0 to size().
+// a batch is posted and waited with atomics. workers spin a little before they sleep,
+// and the caller takes the mutex only to wake a sleeping one, it is never held long by anyone.
+class WorkerPool {
+private:
+    static constexpr int32_t spinCount = 256;  // yields before a worker sleeps.
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    const std::function<void(int32_t, int32_t)>* job = nullptr;  // (job index, worker index)
+    int32_t jobCount = 0;
+    std::atomic<int32_t> nextJob {0};
+    std::atomic<int32_t> busyWorkers {0};
+    std::atomic<uint64_t> generation {0};
+    std::atomic<int32_t> sleepers {0};
+    std::atomic<bool> isQuit {false};
+    bool isPosted(uint64_t) const;
+    void workerLoop(int32_t, uint64_t);
+    void runJobs(int32_t);
+public:
+    ~WorkerPool();
+    void resize(int32_t);
+    int32_t size(void) const;
+    void run(int32_t, const std::function<void(int32_t, int32_t)> &);
+};
+
+#endif // WORKERPOOL_H
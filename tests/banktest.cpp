@@ -0,0 +1,106 @@
+/**************************************************************************/
+/*  banktest.cpp                                                          */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "testing.hpp"
+#include "sequencer.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+// FNV-1a of the body, written again after a test changed it, so only the validation rejects it.
+static void resealBank(std::vector<uint8_t> &bytes) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = sizeof(BankFileHeader); i < bytes.size(); i++) {
+        hash = (hash ^ bytes[i])*16777619u;
+    }
+    std::memcpy(bytes.data() + offsetof(BankFileHeader, checksum), &hash, sizeof(hash));
+}
+
+static std::vector<uint8_t> makeBankBytes(void) {
+    Sequencer source;
+    source.initParam(48000.0, 0.01, 480);
+    std::vector<uint8_t> bytes(Sequencer::bankFileSize);
+    source.getBankBytes(bytes.data());
+    return bytes;
+}
+
+TEST_CASE(bankBytesRoundTrip) {
+    std::vector<uint8_t> bytes = makeBankBytes();
+    CHECK(std::memcmp(bytes.data(), "GDSB", 4) == 0);
+    Sequencer target;
+    target.initParam(48000.0, 0.01, 480);
+    uint64_t version = target.getInstrumentVersion();
+    CHECK(target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+    CHECK(target.getInstrumentVersion() == version + 1);
+    std::vector<uint8_t> again(Sequencer::bankFileSize);
+    target.getBankBytes(again.data());
+    CHECK(again == bytes);
+}
+
+TEST_CASE(bankBytesAreValidated) {
+    const std::vector<uint8_t> good = makeBankBytes();
+    const size_t body = sizeof(BankFileHeader);
+    Sequencer target;
+    target.initParam(48000.0, 0.01, 480);
+    uint64_t version = target.getInstrumentVersion();
+
+    CHECK(!target.setBankBytes(nullptr, Sequencer::bankFileSize));
+    CHECK(!target.setBankBytes(good.data(), (int64_t)good.size() - 1));
+
+    std::vector<uint8_t> bytes = good;
+    bytes[body + 5] ^= 0x40; // checksum does not match.
+    CHECK(!target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+
+    bytes = good;
+    bytes[0] = 'X';
+    CHECK(!target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+
+    bytes = good;
+    uint32_t wrongVersion = Sequencer::bankFileVersion + 1;
+    std::memcpy(bytes.data() + offsetof(BankFileHeader, version), &wrongVersion, 4);
+    CHECK(!target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+
+    bytes = good;
+    float nan = std::numeric_limits<float>::quiet_NaN();
+    std::memcpy(bytes.data() + body + sizeof(Instrument)*3 + offsetof(Instrument, totalGain), &nan, 4);
+    resealBank(bytes);
+    CHECK(!target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+
+    bytes = good;
+    int32_t key = 128;
+    std::memcpy(bytes.data() + body + sizeof(Instrument)*Sequencer::numinstruments + offsetof(Percussion, key), &key, 4);
+    resealBank(bytes);
+    CHECK(!target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+
+    CHECK(target.getInstrumentVersion() == version); // a rejected bank changes nothing.
+    bytes = good;
+    resealBank(bytes);
+    CHECK(target.setBankBytes(bytes.data(), (int64_t)bytes.size()));
+}
@@ -0,0 +1,131 @@
+/**************************************************************************/
+/*  ringtest.cpp                                                          */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "testing.hpp"
+#include "mpscqueue.hpp"
+#include "pcmring.hpp"
+#include <thread>
+
+struct Record {
+    int32_t producer;
+    int32_t sequence;
+};
+
+TEST_CASE(mpscQueueKeepsOrderAndCapacity) {
+    MpscQueue<Record> queue(5); // rounded up to 8.
+    for (int32_t i = 0; i < 8; i++) CHECK(queue.push({0, i}));
+    CHECK(!queue.push({0, 8}));
+    Record one;
+    for (int32_t lap = 0; lap < 3; lap++) { // cells are reused on each lap.
+        for (int32_t i = 0; i < 8; i++) {
+            CHECK(queue.pop(one));
+            CHECK(one.sequence == lap*8 + i);
+            CHECK(queue.push({0, (lap + 1)*8 + i}));
+        }
+    }
+    for (int32_t i = 0; i < 8; i++) CHECK(queue.pop(one));
+    CHECK(!queue.pop(one));
+}
+
+TEST_CASE(mpscQueueTakesManyProducers) {
+    constexpr int32_t producers = 4;
+    constexpr int32_t records = 20000;
+    MpscQueue<Record> queue(256);
+    std::vector<std::thread> threads;
+    for (int32_t p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p]() {
+            for (int32_t i = 0; i < records; i++) {
+                while (!queue.push({p, i})) std::this_thread::yield();
+            }
+        });
+    }
+    std::vector<int32_t> next(producers, 0);
+    int32_t popped = 0;
+    bool isOrdered = true;
+    Record one;
+    while (popped < producers*records) {
+        if (!queue.pop(one)) {
+            std::this_thread::yield();
+            continue;
+        }
+        isOrdered = isOrdered && (one.sequence == next[one.producer]); // each producer is in its own order.
+        next[one.producer] = one.sequence + 1;
+        popped++;
+    }
+    for (auto &thread : threads) thread.join();
+    CHECK(isOrdered);
+    CHECK(!queue.pop(one));
+}
+
+TEST_CASE(pcmRingWrapsAndLimits) {
+    PcmRing ring;
+    ring.init(100); // rounded up to 128 frames.
+    CHECK(ring.getCapacity() == 128);
+    std::vector<float> src(200*2), dst(200*2);
+    for (size_t i = 0; i < src.size(); i++) src[i] = (float)i;
+    CHECK(ring.write(src.data(), 100) == 100);
+    CHECK(ring.read(dst.data(), 60) == 60);
+    CHECK(ring.write(src.data() + 100*2, 100) == 88); // only free frames are taken.
+    CHECK(ring.readable() == 128);
+    CHECK(ring.writable() == 0);
+    CHECK(ring.read(dst.data() + 60*2, 200) == 128);
+    bool isSame = true;
+    for (int32_t i = 0; i < 188*2; i++) isSame = isSame && (dst[i] == src[i]);
+    CHECK(isSame);
+    CHECK(ring.readable() == 0);
+    CHECK(ring.read(dst.data(), 1) == 0);
+}
+
+TEST_CASE(pcmRingPassesFramesBetweenThreads) {
+    constexpr int32_t frames = 100000;
+    PcmRing ring;
+    ring.init(256);
+    std::thread producer([&ring]() {
+        float block[64*2];
+        int32_t written = 0;
+        while (written < frames) {
+            int32_t n = std::min(64, frames - written);
+            for (int32_t i = 0; i < n; i++) block[i*2] = block[i*2+1] = (float)(written + i);
+            int32_t done = (int32_t)ring.write(block, n);
+            if (done == 0) std::this_thread::yield();
+            written += done;
+        }
+    });
+    float block[100*2];
+    int32_t read = 0;
+    bool isSame = true;
+    while (read < frames) {
+        int32_t n = (int32_t)ring.read(block, 100);
+        if (n == 0) std::this_thread::yield();
+        for (int32_t i = 0; i < n; i++) isSame = isSame && (block[i*2] == (float)(read + i)) && (block[i*2+1] == (float)(read + i));
+        read += n;
+    }
+    producer.join();
+    CHECK(isSame);
+}
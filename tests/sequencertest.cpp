@@ -0,0 +1,117 @@
+/**************************************************************************/
+/*  sequencertest.cpp                                                     */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "testing.hpp"
+#include "sequencer.hpp"
+#include <cmath>
+#include <cstring>
+
+// reaches the render side params which have no setter without the engine.
+struct SequencerTest {
+    static void setParallelVoices(Sequencer &sequencer, int32_t voices) {
+        sequencer.parallelVoices = voices;
+    }
+    static void setNoiseSeed(Sequencer &sequencer, uint32_t seed) {
+        sequencer.noiseSeed = seed;
+    }
+    static int32_t getQueueSize(void) {
+        return Sequencer::commandQueueSize;
+    }
+    static size_t getPendingCommands(const Sequencer &sequencer) {
+        return sequencer.pendingCommands.size();
+    }
+};
+
+// a full heap of commands far ahead holds a due note in the queue, it is neither lost nor applied early.
+TEST_CASE(commandHeapOverflow) {
+    constexpr int32_t frames = 256;
+    constexpr int32_t later = 48000;
+    Sequencer sequencer;
+    sequencer.initParam(48000.0, frames/48000.0, frames);
+    std::vector<float> bus(frames*2);
+    int32_t size = SequencerTest::getQueueSize();
+    std::vector<int32_t> records;
+    for (int32_t i = 0; i < size; i++) {
+        records.insert(records.end(), {later + i%64, 0, 60, 0, 0, 0}); // note offs of a note not ringing.
+    }
+    CHECK(sequencer.submitNotes(records.data(), size) == size);
+    CHECK(sequencer.submitNotes(records.data(), 1) == 0); // the queue is full.
+    sequencer.feed(bus.data());
+    CHECK(SequencerTest::getPendingCommands(sequencer) == (size_t)size);
+
+    const int32_t noteOn[Sequencer::noteRecordStride] = {0, 0, 64, 100, 0, 1};
+    CHECK(sequencer.submitNotes(noteOn, 1) == 1);
+    sequencer.feed(bus.data());
+    CHECK(sequencer.getActiveVoices() == 0);
+    while (sequencer.getSampleClock() < later) {
+        sequencer.feed(bus.data());
+        if (sequencer.getSampleClock() < later) CHECK(sequencer.getActiveVoices() == 0);
+    }
+    sequencer.feed(bus.data()); // the frame of the due note offs, room is made for the note on.
+    CHECK(sequencer.getActiveVoices() == 1);
+    while (SequencerTest::getPendingCommands(sequencer) > 0 && sequencer.getSampleClock() < later*2) {
+        sequencer.feed(bus.data());
+    }
+    CHECK(SequencerTest::getPendingCommands(sequencer) == 0);
+}
+
+static std::vector<float> renderNotes(int32_t threads, int32_t parallelVoices) {
+    Sequencer sequencer;
+    sequencer.setRenderThreads(threads);
+    SequencerTest::setParallelVoices(sequencer, parallelVoices);
+    SequencerTest::setNoiseSeed(sequencer, 0);
+    sequencer.initParam(44100.0, 0.05, 2205);
+    for (int32_t k = 0; k < 40; k++) {
+        sequencer.noteOn(k*300, (k%16 == 9) ? 0 : k%16, 30 + k, 100, (k*7)%128);
+    }
+    std::vector<float> out;
+    std::vector<float> bus(2205*2);
+    for (int32_t b = 0; b < 40; b++) {
+        sequencer.feed(bus.data());
+        out.insert(out.end(), bus.begin(), bus.end());
+    }
+    return out;
+}
+
+// groups are summed in fixed order, so the number of threads does not change a bit of the output.
+TEST_CASE(groupReductionIsDeterministic) {
+    std::vector<float> one = renderNotes(0, 1);
+    std::vector<float> many = renderNotes(3, 1);
+    std::vector<float> serial = renderNotes(0, Sequencer::maxVoices + 1);
+    CHECK(one.size() == many.size());
+    CHECK(std::memcmp(one.data(), many.data(), one.size()*sizeof(float)) == 0);
+    double diff = 0.0;
+    double peak = 0.0;
+    for (size_t i = 0; i < one.size(); i++) {
+        diff = std::max(diff, (double)std::fabs(one[i] - serial[i]));
+        peak = std::max(peak, (double)std::fabs(serial[i]));
+    }
+    CHECK(peak > 0.01);
+    CHECK(diff < 1e-5); // only the order of float sums differs from the serial render.
+}
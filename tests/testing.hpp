@@ -0,0 +1,66 @@
+/**************************************************************************/
+/*  testing.hpp                                                           */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#ifndef TESTING_H
+#define TESTING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// native tests of the parts that run without the engine, no framework is needed.
+// TEST_CASE registers a function, CHECK reports the failed line and the test goes on.
+struct TestCase {
+    const char *name;
+    void (*run)(void);
+};
+
+std::vector<TestCase> &testCases(void);
+extern int32_t testFailures;
+
+struct TestRegistrar {
+    TestRegistrar(const char *name, void (*run)(void)) {
+        testCases().push_back({name, run});
+    }
+};
+
+#define TEST_CASE(name) \
+    static void name(void); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name(void)
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#endif // TESTING_H
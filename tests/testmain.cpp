@@ -0,0 +1,51 @@
+/**************************************************************************/
+/*  testmain.cpp                                                          */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "testing.hpp"
+
+int32_t testFailures = 0;
+
+std::vector<TestCase> &testCases(void) {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+// runs all tests, returns 1 when any check failed.
+int main() {
+    int32_t failedCases = 0;
+    for (const auto &one : testCases()) {
+        int32_t before = testFailures;
+        one.run();
+        bool isPassed = (testFailures == before);
+        if (!isPassed) failedCases++;
+        std::printf("%s %s\n", isPassed ? "ok    " : "FAILED", one.name);
+    }
+    std::printf("%d of %d tests failed\n", failedCases, (int32_t)testCases().size());
+    return failedCases == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/**************************************************************************/
+/*  wavtest.cpp                                                           */
+/**************************************************************************/
+/*                         This file is part of:                          */
+/*                             GDSynthesizer                              */
+/**************************************************************************/
+/* Copyright (c) 2023-2024 Soyo Kuyo.                                     */
+/*                                                                        */
+/* Permission is hereby granted, free of charge, to any person obtaining  */
+/* a copy of this software and associated documentation files (the        */
+/* "Software"), to deal in the Software without restriction, including    */
+/* without limitation the rights to use, copy, modify, merge, publish,    */
+/* distribute, sublicense, and/or sell copies of the Software, and to     */
+/* permit persons to whom the Software is furnished to do so, subject to  */
+/* the following conditions:                                              */
+/*                                                                        */
+/* The above copyright notice and this permission notice shall be         */
+/* included in all copies or substantial portions of the Software.        */
+/*                                                                        */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,        */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF     */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. */
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY   */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,   */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE      */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                 */
+/**************************************************************************/
+
+
+#include "testing.hpp"
+#include "offlinerender.hpp"
+#include <cstring>
+
+static uint32_t getLE(const uint8_t *src, int32_t bytes) {
+    uint32_t value = 0;
+    for (int32_t i = 0; i < bytes; i++) value |= (uint32_t)src[i] << (i*8);
+    return value;
+}
+
+TEST_CASE(wavHeaderOfPcm) {
+    uint8_t header[OfflineRender::maxWavHeaderSize];
+    for (int32_t bits : {16, 24}) {
+        int32_t blockAlign = 2*bits/8;
+        CHECK(OfflineRender::wavHeaderSize(bits) == 44);
+        OfflineRender::makeWavHeader(header, 48000, bits, 1000);
+        CHECK(std::memcmp(header, "RIFF", 4) == 0);
+        CHECK(getLE(header + 4, 4) == (uint32_t)(36 + 1000*blockAlign));
+        CHECK(std::memcmp(header + 8, "WAVEfmt ", 8) == 0);
+        CHECK(getLE(header + 16, 4) == 16);
+        CHECK(getLE(header + 20, 2) == 1); // PCM.
+        CHECK(getLE(header + 22, 2) == 2);
+        CHECK(getLE(header + 24, 4) == 48000);
+        CHECK(getLE(header + 28, 4) == (uint32_t)(48000*blockAlign));
+        CHECK(getLE(header + 32, 2) == (uint32_t)blockAlign);
+        CHECK(getLE(header + 34, 2) == (uint32_t)bits);
+        CHECK(std::memcmp(header + 36, "data", 4) == 0);
+        CHECK(getLE(header + 40, 4) == (uint32_t)(1000*blockAlign));
+    }
+}
+
+TEST_CASE(wavHeaderOfFloat) {
+    uint8_t header[OfflineRender::maxWavHeaderSize];
+    CHECK(OfflineRender::wavHeaderSize(32) == 58);
+    OfflineRender::makeWavHeader(header, 44100, 32, 1000);
+    CHECK(getLE(header + 4, 4) == 50 + 8000);
+    CHECK(getLE(header + 16, 4) == 18);
+    CHECK(getLE(header + 20, 2) == 3); // IEEE float.
+    CHECK(getLE(header + 36, 2) == 0); // cbSize.
+    CHECK(std::memcmp(header + 38, "fact", 4) == 0);
+    CHECK(getLE(header + 42, 4) == 4);
+    CHECK(getLE(header + 46, 4) == 1000);
+    CHECK(std::memcmp(header + 50, "data", 4) == 0);
+    CHECK(getLE(header + 54, 4) == 8000);
+}
+
+TEST_CASE(wavHeaderSaturatesOver4GB) {
+    uint8_t header[OfflineRender::maxWavHeaderSize];
+    OfflineRender::makeWavHeader(header, 48000, 16, (int64_t)1 << 31);
+    CHECK(getLE(header + 4, 4) == 0xffffffffu);
+    CHECK(getLE(header + 40, 4) == 0xffffffffu - 36);
+}
+
+TEST_CASE(wavFramesAreEncodedAndClipped) {
+    const float src[4] = {1.0f, -1.0f, 2.0f, 0.5f};
+    uint8_t dst[4*4];
+    CHECK(OfflineRender::encodeFrames(src, 2, 16, dst) == 8);
+    CHECK((int16_t)getLE(dst, 2) == 32767);
+    CHECK((int16_t)getLE(dst + 2, 2) == -32767);
+    CHECK((int16_t)getLE(dst + 4, 2) == 32767);
+    CHECK((int16_t)getLE(dst + 6, 2) == 16384);
+    CHECK(OfflineRender::encodeFrames(src, 2, 24, dst) == 12);
+    CHECK(getLE(dst, 3) == 0x7fffff);
+    CHECK(getLE(dst + 3, 3) == 0x800001);
+    CHECK(OfflineRender::encodeFrames(src, 2, 32, dst) == 16);
+    float value;
+    std::memcpy(&value, dst + 8, 4);
+    CHECK(value == 2.0f); // float keeps the value, the render clips it before.
+    CHECK(OfflineRender::isValidBits(16) && OfflineRender::isValidBits(24) && OfflineRender::isValidBits(32));
+    CHECK(!OfflineRender::isValidBits(8));
+}